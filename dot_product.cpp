@@ -8,6 +8,35 @@
 #include <thread>
 #include <chrono>
 #include <queue>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <cmath>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+enum class PipelineStrategy { MUTEX_QUEUE, SPSC_RING, PARALLEL_REDUCTION, MAPPED_STREAM };
+
+static constexpr std::size_t DEFAULT_VECTOR_SIZE = 10000000;
+static constexpr std::size_t DEFAULT_CHUNK_SIZE = 4096;
+static constexpr std::size_t DEFAULT_RING_CHUNK_COUNT = 16;
+static constexpr unsigned int DEFAULT_SPIN_COUNT = 1 << 10;
+static constexpr std::size_t DEFAULT_MAPPED_WINDOW_BYTES = 16 << 20;
+static constexpr unsigned int DEFAULT_WARMUP_COUNT = 1;
+static constexpr unsigned int DEFAULT_TRIAL_COUNT = 5;
+
+static constexpr std::size_t CACHE_LINE_SIZE = 64;
 
 std::condition_variable condition;
 std::mutex mutex;
@@ -15,11 +44,31 @@ std::queue<uint64_t> product_queue;
 bool done = false;
 uint64_t result;
 
+// Slow-path synchronization events, summed over all threads of one run.
+struct PipelineCounters {
+    std::atomic<uint64_t> lock_acquisitions{0};
+    std::atomic<uint64_t> wakeups{0};
+
+    void reset() {
+        lock_acquisitions = 0;
+        wakeups = 0;
+    }
+};
+
+PipelineCounters pipeline_counters;
+
 void consumer() {
+    uint64_t lock_acquisitions = 0;
+    uint64_t wakeups = 0;
+
     for (;;) {
         std::unique_lock<std::mutex> lock(mutex);
+        lock_acquisitions++;
 
-        condition.wait(lock, []() { return !product_queue.empty() || done; });
+        while (product_queue.empty() && !done) {
+            condition.wait(lock);
+            wakeups++;
+        }
 
         while (!product_queue.empty()) {
             result += product_queue.front();
@@ -29,16 +78,22 @@ void consumer() {
         if (done)
             break;
     }
+
+    pipeline_counters.lock_acquisitions += lock_acquisitions;
+    pipeline_counters.wakeups += wakeups;
 }
 
-void producer(const std::vector<uint32_t> a_vec,
-              const std::vector<uint32_t> b_vec) {
+void producer(const std::vector<uint32_t>& a_vec,
+              const std::vector<uint32_t>& b_vec) {
     std::size_t current_index = 0;
+    uint64_t lock_acquisitions = 0;
+
     for (;;) {
-        uint64_t product = a_vec[current_index] * b_vec[current_index];
+        uint64_t product = uint64_t(a_vec[current_index]) * b_vec[current_index];
         current_index++;
 
         std::lock_guard<std::mutex> lock(mutex);
+        lock_acquisitions++;
 
         product_queue.push(product);
         condition.notify_one();
@@ -50,34 +105,747 @@ void producer(const std::vector<uint32_t> a_vec,
             break;
         }
     }
+
+    pipeline_counters.lock_acquisitions += lock_acquisitions;
 }
 
-uint32_t random_int(uint32_t lowerBound, uint32_t upperBound) {
-    std::random_device dev;
-    std::mt19937 rng(dev());
-    std::uniform_int_distribution<std::mt19937::result_type> dist(lowerBound, upperBound);
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Spins on the predicate for a while and only falls back to a condition
+// variable once spinning stops paying off. notify() only touches the mutex
+// when the other side has actually gone to sleep.
+class SpinThenParkWaiter {
+    private:
+        const unsigned int spin_count;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> parked{false};
+
+    public:
+        explicit SpinThenParkWaiter(unsigned int spin_count) : spin_count(spin_count) {}
+
+        template <typename Predicate>
+        void wait(Predicate ready) {
+            for (unsigned int spin = 0; spin < spin_count; spin++) {
+                if (ready())
+                    return;
+
+                cpu_relax();
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            pipeline_counters.lock_acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+            parked.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            while (!ready()) {
+                condition.wait(lock);
+                pipeline_counters.wakeups.fetch_add(1, std::memory_order_relaxed);
+            }
+            parked.store(false, std::memory_order_relaxed);
+        }
+
+        void notify() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!parked.load(std::memory_order_relaxed))
+                return;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            pipeline_counters.lock_acquisitions.fetch_add(1, std::memory_order_relaxed);
+
+            condition.notify_one();
+        }
+};
+
+// Bounded single-producer/single-consumer ring of fixed-size chunks. The
+// producer fills a chunk in place and publishes it with one release store,
+// so synchronization cost is paid once per chunk instead of once per element.
+class ChunkRingBuffer {
+    private:
+        const std::size_t chunk_count;
+        const std::size_t chunk_size;
+
+        std::vector<uint64_t> slots;
+        std::vector<std::size_t> slot_sizes;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> head{0};
+        std::size_t cached_tail = 0;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> tail{0};
+        std::size_t cached_head = 0;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<bool> closed{false};
+
+        SpinThenParkWaiter not_empty;
+        SpinThenParkWaiter not_full;
+
+    public:
+        ChunkRingBuffer(std::size_t chunk_count, std::size_t chunk_size, unsigned int spin_count)
+            : chunk_count(chunk_count), chunk_size(chunk_size),
+            slots(chunk_count * chunk_size), slot_sizes(chunk_count, 0),
+            not_empty(spin_count), not_full(spin_count) {}
+
+        std::size_t get_chunk_size() const {
+            return chunk_size;
+        }
+
+        uint64_t* acquire_write_chunk() {
+            const std::size_t current_tail = tail.load(std::memory_order_relaxed);
+
+            if (current_tail - cached_head == chunk_count) {
+                not_full.wait([this, current_tail]() {
+                    cached_head = head.load(std::memory_order_acquire);
+                    return current_tail - cached_head < chunk_count;
+                });
+            }
+
+            return &slots[(current_tail % chunk_count) * chunk_size];
+        }
+
+        void commit_write_chunk(std::size_t element_count) {
+            const std::size_t current_tail = tail.load(std::memory_order_relaxed);
+
+            slot_sizes[current_tail % chunk_count] = element_count;
+            tail.store(current_tail + 1, std::memory_order_release);
+
+            not_empty.notify();
+        }
+
+        bool acquire_read_chunk(const uint64_t*& chunk, std::size_t& element_count) {
+            const std::size_t current_head = head.load(std::memory_order_relaxed);
+
+            if (current_head == cached_tail) {
+                not_empty.wait([this, current_head]() {
+                    cached_tail = tail.load(std::memory_order_acquire);
+                    return current_head != cached_tail || closed.load(std::memory_order_acquire);
+                });
+
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (current_head == cached_tail)
+                    return false;
+            }
+
+            chunk = &slots[(current_head % chunk_count) * chunk_size];
+            element_count = slot_sizes[current_head % chunk_count];
+
+            return true;
+        }
+
+        void release_read_chunk() {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+            not_full.notify();
+        }
+
+        void close() {
+            closed.store(true, std::memory_order_release);
+
+            not_empty.notify();
+        }
+};
+
+void ring_consumer(ChunkRingBuffer& ring) {
+    const uint64_t* chunk;
+    std::size_t element_count;
+
+    while (ring.acquire_read_chunk(chunk, element_count)) {
+        uint64_t partial_sum = 0;
+        for (std::size_t index = 0; index < element_count; index++)
+            partial_sum += chunk[index];
+
+        result += partial_sum;
+        ring.release_read_chunk();
+    }
+}
+
+void ring_produce_range(const uint32_t* a, const uint32_t* b, std::size_t count,
+                        ChunkRingBuffer& ring) {
+    const std::size_t chunk_size = ring.get_chunk_size();
+
+    for (std::size_t chunk_start = 0; chunk_start < count; chunk_start += chunk_size) {
+        const std::size_t element_count = std::min(chunk_size, count - chunk_start);
+
+        uint64_t* chunk = ring.acquire_write_chunk();
+        for (std::size_t index = 0; index < element_count; index++)
+            chunk[index] = uint64_t(a[chunk_start + index]) * b[chunk_start + index];
+
+        ring.commit_write_chunk(element_count);
+    }
+}
+
+void ring_producer(const std::vector<uint32_t>& a_vec,
+                   const std::vector<uint32_t>& b_vec,
+                   ChunkRingBuffer& ring) {
+    ring_produce_range(a_vec.data(), b_vec.data(), a_vec.size(), ring);
+    ring.close();
+}
+
+// Read-only mapping of a raw native-endian uint32_t vector file. The data is
+// never copied into the heap; pages are faulted in on demand and can be
+// dropped again once consumed, so the file may exceed physical memory.
+class MappedVectorFile {
+    private:
+        int fd = -1;
+        const uint32_t* mapping = nullptr;
+        std::size_t byte_size = 0;
+
+    public:
+        explicit MappedVectorFile(const std::string& path) {
+            fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("Cannot open vector file " + path + ": " + std::strerror(errno));
+
+            struct stat file_stat;
+            if (fstat(fd, &file_stat) < 0) {
+                close(fd);
+                throw std::runtime_error("Cannot stat vector file " + path + ": " + std::strerror(errno));
+            }
+
+            byte_size = file_stat.st_size;
+            if (byte_size % sizeof(uint32_t) != 0) {
+                close(fd);
+                throw std::runtime_error("Vector file " + path + " is not a whole number of uint32_t values!");
+            }
+
+            if (byte_size == 0)
+                return;
+
+            void* address = mmap(nullptr, byte_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                close(fd);
+                throw std::runtime_error("Cannot map vector file " + path + ": " + std::strerror(errno));
+            }
+
+            mapping = static_cast<const uint32_t*>(address);
+            madvise(address, byte_size, MADV_SEQUENTIAL);
+        }
+
+        MappedVectorFile(const MappedVectorFile&) = delete;
+        MappedVectorFile& operator=(const MappedVectorFile&) = delete;
+
+        ~MappedVectorFile() {
+            if (mapping)
+                munmap(const_cast<uint32_t*>(mapping), byte_size);
+            if (fd >= 0)
+                close(fd);
+        }
+
+        const uint32_t* data() const {
+            return mapping;
+        }
+
+        std::size_t size() const {
+            return byte_size / sizeof(uint32_t);
+        }
+
+        void advise(std::size_t start_index, std::size_t count, int advice) const {
+            if (count == 0)
+                return;
+
+            madvise(const_cast<uint32_t*>(mapping + start_index), count * sizeof(uint32_t), advice);
+        }
+};
+
+std::size_t page_aligned_window_elements(std::size_t window_bytes) {
+    const std::size_t page_size = sysconf(_SC_PAGESIZE);
+    const std::size_t aligned_bytes = std::max(page_size, window_bytes / page_size * page_size);
+
+    return aligned_bytes / sizeof(uint32_t);
+}
+
+// Streams both files through the ring one window at a time. Window starts are
+// multiples of the page size, so the next window can be prefetched with
+// MADV_WILLNEED while the current one is multiplied, and the finished one
+// released with MADV_DONTNEED to keep the resident set bounded.
+void mapped_ring_producer(const MappedVectorFile& a_file,
+                          const MappedVectorFile& b_file,
+                          std::size_t window_bytes,
+                          ChunkRingBuffer& ring) {
+    const std::size_t window_elements = page_aligned_window_elements(window_bytes);
+    const std::size_t element_count = a_file.size();
+
+    for (std::size_t window_start = 0; window_start < element_count; window_start += window_elements) {
+        const std::size_t window_size = std::min(window_elements, element_count - window_start);
+        const std::size_t next_window_start = window_start + window_size;
+        const std::size_t next_window_size = std::min(window_elements, element_count - next_window_start);
+
+        a_file.advise(next_window_start, next_window_size, MADV_WILLNEED);
+        b_file.advise(next_window_start, next_window_size, MADV_WILLNEED);
+
+        ring_produce_range(a_file.data() + window_start, b_file.data() + window_start, window_size, ring);
+
+        a_file.advise(window_start, window_size, MADV_DONTNEED);
+        b_file.advise(window_start, window_size, MADV_DONTNEED);
+    }
+
+    ring.close();
+}
+
+typedef uint64_t (*DotProductKernel)(const uint32_t*, const uint32_t*, std::size_t);
+
+uint64_t dot_product_scalar(const uint32_t* a, const uint32_t* b, std::size_t count) {
+    uint64_t sum = 0;
+    for (std::size_t index = 0; index < count; index++)
+        sum += uint64_t(a[index]) * b[index];
+
+    return sum;
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+// _mm_mul_epu32 only multiplies the even 32-bit lanes into 64-bit products,
+// so the odd lanes are shifted down and multiplied in a second pass.
+__attribute__((target("sse2")))
+uint64_t dot_product_sse2(const uint32_t* a, const uint32_t* b, std::size_t count) {
+    __m128i sum = _mm_setzero_si128();
+
+    std::size_t index = 0;
+    for (; index + 4 <= count; index += 4) {
+        const __m128i a_lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + index));
+        const __m128i b_lanes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + index));
+
+        sum = _mm_add_epi64(sum, _mm_mul_epu32(a_lanes, b_lanes));
+        sum = _mm_add_epi64(sum, _mm_mul_epu32(_mm_srli_epi64(a_lanes, 32), _mm_srli_epi64(b_lanes, 32)));
+    }
 
-    return dist(rng);
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sum);
+
+    return lanes[0] + lanes[1] + dot_product_scalar(a + index, b + index, count - index);
+}
+
+__attribute__((target("avx2")))
+uint64_t dot_product_avx2(const uint32_t* a, const uint32_t* b, std::size_t count) {
+    __m256i even_sum = _mm256_setzero_si256();
+    __m256i odd_sum = _mm256_setzero_si256();
+
+    std::size_t index = 0;
+    for (; index + 8 <= count; index += 8) {
+        const __m256i a_lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + index));
+        const __m256i b_lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + index));
+
+        even_sum = _mm256_add_epi64(even_sum, _mm256_mul_epu32(a_lanes, b_lanes));
+        odd_sum = _mm256_add_epi64(odd_sum, 
+                _mm256_mul_epu32(_mm256_srli_epi64(a_lanes, 32), _mm256_srli_epi64(b_lanes, 32)));
+    }
+
+    alignas(32) uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), _mm256_add_epi64(even_sum, odd_sum));
+
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] 
+        + dot_product_scalar(a + index, b + index, count - index);
+}
+#endif
+
+DotProductKernel select_dot_product_kernel() {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("avx2"))
+        return dot_product_avx2;
+
+    return dot_product_sse2;
+#else
+    return dot_product_scalar;
+#endif
+}
+
+uint64_t parallel_dot_product(const std::vector<uint32_t>& a_vec,
+                              const std::vector<uint32_t>& b_vec,
+                              unsigned int worker_count) {
+    const DotProductKernel kernel = select_dot_product_kernel();
+
+    const std::size_t elements_per_worker = a_vec.size() / worker_count;
+    const std::size_t remainder = a_vec.size() % worker_count;
+
+    std::vector<uint64_t> partial_sums(worker_count, 0);
+    std::vector<std::thread> workers;
+    workers.reserve(worker_count);
+
+    std::size_t range_start = 0;
+    for (unsigned int worker_index = 0; worker_index < worker_count; worker_index++) {
+        const std::size_t range_size = elements_per_worker + (worker_index < remainder ? 1 : 0);
+
+        // Each worker accumulates into a register and writes its slot once,
+        // so the shared partial_sums vector never bounces between caches.
+        workers.emplace_back([&, worker_index, range_start, range_size]() {
+            partial_sums[worker_index] = kernel(a_vec.data() + range_start, 
+                                                b_vec.data() + range_start, range_size);
+        });
+
+        range_start += range_size;
+    }
+
+    uint64_t sum = 0;
+    for (unsigned int worker_index = 0; worker_index < worker_count; worker_index++) {
+        workers[worker_index].join();
+        sum += partial_sums[worker_index];
+    }
+
+    return sum;
 }
 
 std::vector<uint32_t> gen_random_uint_vec(std::size_t size) {
+    std::random_device dev;
+    std::mt19937 rng(dev());
+    std::uniform_int_distribution<uint32_t> dist(0, std::numeric_limits<uint32_t>::max());
+
     std::vector<uint32_t> vec(size);
-    std::generate(vec.begin(), vec.end(), []() {
-        return random_int(0, std::numeric_limits<uint32_t>::max()); 
-    });
+    std::generate(vec.begin(), vec.end(), [&]() { return dist(rng); });
 
     return vec;
 }
 
-int main() {
-//    std::thread producer_thread(producer, gen_random_uint_vec(10000), gen_random_uint_vec(10000));
-    std::thread producer_thread(producer, std::vector<uint32_t>(500, 2), std::vector<uint32_t>(500, 2));
-    std::thread consumer_thread(consumer);
+// Writes a random vector file block by block, so files larger than memory can
+// be produced for the mapped mode.
+void gen_random_uint_vec_file(const std::string& path, std::size_t size) {
+    static constexpr std::size_t BLOCK_SIZE = 1 << 20;
+
+    std::random_device dev;
+    std::mt19937 rng(dev());
+    std::uniform_int_distribution<uint32_t> dist(0, std::numeric_limits<uint32_t>::max());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Cannot create vector file " + path);
+
+    std::vector<uint32_t> block;
+    block.reserve(BLOCK_SIZE);
+    for (std::size_t written = 0; written < size; written += block.size()) {
+        block.resize(std::min(BLOCK_SIZE, size - written));
+        std::generate(block.begin(), block.end(), [&]() { return dist(rng); });
+
+        file.write(reinterpret_cast<const char*>(block.data()), block.size() * sizeof(uint32_t));
+    }
+}
+
+struct PipelineOptions {
+    std::size_t chunk_size = DEFAULT_CHUNK_SIZE;
+    std::size_t ring_chunk_count = DEFAULT_RING_CHUNK_COUNT;
+    unsigned int spin_count = DEFAULT_SPIN_COUNT;
+    std::size_t mapped_window_bytes = DEFAULT_MAPPED_WINDOW_BYTES;
+};
+
+uint64_t mapped_dot_product(const MappedVectorFile& a_file, const MappedVectorFile& b_file,
+                            const PipelineOptions& options) {
+    result = 0;
+    ChunkRingBuffer ring(options.ring_chunk_count, options.chunk_size, options.spin_count);
+
+    std::thread producer_thread(mapped_ring_producer, 
+            std::cref(a_file), std::cref(b_file), options.mapped_window_bytes, std::ref(ring));
+    std::thread consumer_thread(ring_consumer, std::ref(ring));
 
     producer_thread.join();
     consumer_thread.join();
 
-    std::cout << result << std::endl;
+    return result;
+}
+
+uint64_t run_pipeline(PipelineStrategy strategy, unsigned int worker_count,
+                      const std::vector<uint32_t>& a_vec, const std::vector<uint32_t>& b_vec,
+                      const PipelineOptions& options) {
+    result = 0;
+    done = false;
+
+    if (strategy == PipelineStrategy::MUTEX_QUEUE) {
+        std::thread producer_thread(producer, std::cref(a_vec), std::cref(b_vec));
+        std::thread consumer_thread(consumer);
+
+        producer_thread.join();
+        consumer_thread.join();
+    } else if (strategy == PipelineStrategy::PARALLEL_REDUCTION) {
+        result = parallel_dot_product(a_vec, b_vec, worker_count);
+    } else {
+        ChunkRingBuffer ring(options.ring_chunk_count, options.chunk_size, options.spin_count);
+
+        std::thread producer_thread(ring_producer, std::cref(a_vec), std::cref(b_vec), std::ref(ring));
+        std::thread consumer_thread(ring_consumer, std::ref(ring));
+
+        producer_thread.join();
+        consumer_thread.join();
+    }
+
+    return result;
+}
+
+enum class OutputFormat { CSV, JSON };
+
+struct BenchmarkOptions {
+    std::size_t vector_size = DEFAULT_VECTOR_SIZE;
+    std::vector<PipelineStrategy> strategies = { PipelineStrategy::MUTEX_QUEUE, 
+        PipelineStrategy::SPSC_RING, PipelineStrategy::PARALLEL_REDUCTION };
+    std::vector<unsigned int> worker_counts = { std::max(1u, std::thread::hardware_concurrency()) };
+    unsigned int warmup_count = DEFAULT_WARMUP_COUNT;
+    unsigned int trial_count = DEFAULT_TRIAL_COUNT;
+    OutputFormat format = OutputFormat::CSV;
+    std::string a_file;
+    std::string b_file;
+    // When non-zero, --a-file and --b-file are first written with this many
+    // random elements.
+    std::size_t gen_file_size = 0;
+
+    PipelineOptions pipeline;
+};
+
+struct BenchmarkResult {
+    PipelineStrategy strategy;
+    unsigned int thread_count;
+    std::size_t element_count;
+    std::vector<double> trial_times_ms;
+    uint64_t lock_acquisitions;
+    uint64_t wakeups;
+};
+
+const char* strategy_name(PipelineStrategy strategy) {
+    switch (strategy) {
+        case PipelineStrategy::MUTEX_QUEUE: return "mutex";
+        case PipelineStrategy::SPSC_RING: return "ring";
+        case PipelineStrategy::PARALLEL_REDUCTION: return "parallel";
+        case PipelineStrategy::MAPPED_STREAM: return "mapped";
+    }
+
+    return "unknown";
+}
+
+PipelineStrategy parse_strategy(const std::string& name) {
+    for (auto strategy : { PipelineStrategy::MUTEX_QUEUE, PipelineStrategy::SPSC_RING,
+                           PipelineStrategy::PARALLEL_REDUCTION, PipelineStrategy::MAPPED_STREAM })
+        if (name == strategy_name(strategy))
+            return strategy;
+
+    throw std::runtime_error("Unknown strategy " + name + "!");
+}
+
+std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> items;
+    std::size_t start = 0;
+
+    for (;;) {
+        const std::size_t comma = list.find(',', start);
+        items.push_back(list.substr(start, comma - start));
+
+        if (comma == std::string::npos)
+            return items;
+
+        start = comma + 1;
+    }
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]" << std::endl
+        << "  --size N             vector length (default " << DEFAULT_VECTOR_SIZE << ")" << std::endl
+        << "  --strategy LIST      comma-separated: mutex,ring,parallel,mapped" << std::endl
+        << "  --threads LIST       comma-separated worker counts for the parallel strategy" << std::endl
+        << "  --chunk-size N       elements per ring chunk (default " << DEFAULT_CHUNK_SIZE << ")" << std::endl
+        << "  --ring-chunks N      chunks in the ring (default " << DEFAULT_RING_CHUNK_COUNT << ")" << std::endl
+        << "  --spin N             spins before parking (default " << DEFAULT_SPIN_COUNT << ")" << std::endl
+        << "  --window-bytes N     mapped streaming window (default " << DEFAULT_MAPPED_WINDOW_BYTES << ")" << std::endl
+        << "  --a-file PATH        first vector file for the mapped strategy" << std::endl
+        << "  --b-file PATH        second vector file for the mapped strategy" << std::endl
+        << "  --gen-files N        first write N random elements to --a-file and --b-file" << std::endl
+        << "  --warmup N           untimed runs per configuration (default " << DEFAULT_WARMUP_COUNT << ")" << std::endl
+        << "  --trials N           timed runs per configuration (default " << DEFAULT_TRIAL_COUNT << ")" << std::endl
+        << "  --format csv|json    output format (default csv)" << std::endl;
+}
+
+BenchmarkOptions parse_options(int argc, char** argv) {
+    BenchmarkOptions options;
+
+    for (int arg_index = 1; arg_index < argc; arg_index++) {
+        const std::string arg = argv[arg_index];
+        if (arg_index + 1 >= argc)
+            throw std::runtime_error("Missing value for " + arg + "!");
+
+        const std::string value = argv[++arg_index];
+
+        if (arg == "--size") {
+            options.vector_size = std::stoull(value);
+            if (options.vector_size == 0)
+                throw std::runtime_error("--size must be at least 1!");
+        }
+        else if (arg == "--strategy") {
+            options.strategies.clear();
+            for (const auto& name : split_list(value))
+                options.strategies.push_back(parse_strategy(name));
+        } else if (arg == "--threads") {
+            options.worker_counts.clear();
+            for (const auto& count : split_list(value))
+                options.worker_counts.push_back(std::max(1ul, std::stoul(count)));
+        } else if (arg == "--chunk-size")
+            options.pipeline.chunk_size = std::max(1ull, std::stoull(value));
+        else if (arg == "--ring-chunks")
+            options.pipeline.ring_chunk_count = std::max(1ull, std::stoull(value));
+        else if (arg == "--spin")
+            options.pipeline.spin_count = std::stoul(value);
+        else if (arg == "--window-bytes")
+            options.pipeline.mapped_window_bytes = std::stoull(value);
+        else if (arg == "--a-file")
+            options.a_file = value;
+        else if (arg == "--b-file")
+            options.b_file = value;
+        else if (arg == "--gen-files")
+            options.gen_file_size = std::stoull(value);
+        else if (arg == "--warmup")
+            options.warmup_count = std::stoul(value);
+        else if (arg == "--trials")
+            options.trial_count = std::max(1ul, std::stoul(value));
+        else if (arg == "--format") {
+            if (value == "csv")
+                options.format = OutputFormat::CSV;
+            else if (value == "json")
+                options.format = OutputFormat::JSON;
+            else
+                throw std::runtime_error("Unknown format " + value + "!");
+        } else
+            throw std::runtime_error("Unknown option " + arg + "!");
+    }
+
+    if (options.gen_file_size && (options.a_file.empty() || options.b_file.empty()))
+        throw std::runtime_error("--gen-files needs --a-file and --b-file!");
+
+    return options;
+}
+
+template <typename Run>
+BenchmarkResult benchmark(PipelineStrategy strategy, unsigned int thread_count, std::size_t element_count,
+                          uint64_t expected, const BenchmarkOptions& options, Run run) {
+    BenchmarkResult bench_result { strategy, thread_count, element_count, {}, 0, 0 };
+
+    for (unsigned int warmup = 0; warmup < options.warmup_count; warmup++)
+        run();
+
+    pipeline_counters.reset();
+    for (unsigned int trial = 0; trial < options.trial_count; trial++) {
+        const auto t_start = std::chrono::high_resolution_clock::now();
+        const uint64_t sum = run();
+        const auto t_end = std::chrono::high_resolution_clock::now();
+
+        if (sum != expected)
+            throw std::runtime_error(std::string("Strategy ") + strategy_name(strategy) 
+                    + " computed a wrong dot product!");
+
+        bench_result.trial_times_ms.push_back(std::chrono::duration<double, std::milli>(t_end - t_start).count());
+    }
+
+    bench_result.lock_acquisitions = pipeline_counters.lock_acquisitions / options.trial_count;
+    bench_result.wakeups = pipeline_counters.wakeups / options.trial_count;
+
+    return bench_result;
+}
+
+double percentile(std::vector<double> values, double quantile) {
+    std::sort(values.begin(), values.end());
+    const std::size_t rank = static_cast<std::size_t>(std::ceil(quantile * values.size()));
+
+    return values[std::max<std::size_t>(rank, 1) - 1];
+}
+
+void print_results(const std::vector<BenchmarkResult>& results, OutputFormat format) {
+    if (format == OutputFormat::CSV)
+        std::cout << "strategy,threads,elements,trials,p50_ms,p99_ms,elements_per_s,gb_per_s,"
+            << "lock_acquisitions,wakeups" << std::endl;
+    else
+        std::cout << "[" << std::endl;
+
+    for (std::size_t index = 0; index < results.size(); index++) {
+        const BenchmarkResult& bench_result = results[index];
+
+        const double p50_ms = percentile(bench_result.trial_times_ms, 0.50);
+        const double p99_ms = percentile(bench_result.trial_times_ms, 0.99);
+        const double elements_per_s = bench_result.element_count / (p50_ms / 1000.0);
+        const double gb_per_s = elements_per_s * 2 * sizeof(uint32_t) / 1e9;
+
+        if (format == OutputFormat::CSV) {
+            std::cout << strategy_name(bench_result.strategy) << "," << bench_result.thread_count << ","
+                << bench_result.element_count << "," << bench_result.trial_times_ms.size() << ","
+                << p50_ms << "," << p99_ms << "," << elements_per_s << "," << gb_per_s << ","
+                << bench_result.lock_acquisitions << "," << bench_result.wakeups << std::endl;
+        } else {
+            std::cout << "  {\"strategy\": \"" << strategy_name(bench_result.strategy) << "\""
+                << ", \"threads\": " << bench_result.thread_count
+                << ", \"elements\": " << bench_result.element_count
+                << ", \"trials\": " << bench_result.trial_times_ms.size()
+                << ", \"p50_ms\": " << p50_ms
+                << ", \"p99_ms\": " << p99_ms
+                << ", \"elements_per_s\": " << elements_per_s
+                << ", \"gb_per_s\": " << gb_per_s
+                << ", \"lock_acquisitions\": " << bench_result.lock_acquisitions
+                << ", \"wakeups\": " << bench_result.wakeups << "}"
+                << (index + 1 < results.size() ? "," : "") << std::endl;
+        }
+    }
+
+    if (format == OutputFormat::JSON)
+        std::cout << "]" << std::endl;
+}
+
+// Runs every configured benchmark; the mapped strategy reads (and with
+// --gen-files first writes) its vector files.
+std::vector<BenchmarkResult> run_benchmarks(const BenchmarkOptions& options) {
+    if (options.gen_file_size) {
+        gen_random_uint_vec_file(options.a_file, options.gen_file_size);
+        gen_random_uint_vec_file(options.b_file, options.gen_file_size);
+    }
+
+    const bool needs_memory_vectors = std::any_of(options.strategies.begin(), options.strategies.end(),
+            [](PipelineStrategy strategy) { return strategy != PipelineStrategy::MAPPED_STREAM; });
+
+    std::vector<uint32_t> a_vec;
+    std::vector<uint32_t> b_vec;
+    uint64_t expected = 0;
+    if (needs_memory_vectors) {
+        a_vec = gen_random_uint_vec(options.vector_size);
+        b_vec = gen_random_uint_vec(options.vector_size);
+        expected = select_dot_product_kernel()(a_vec.data(), b_vec.data(), a_vec.size());
+    }
+
+    std::vector<BenchmarkResult> results;
+    for (const auto strategy : options.strategies) {
+        if (strategy == PipelineStrategy::MAPPED_STREAM) {
+            if (options.a_file.empty() || options.b_file.empty())
+                throw std::runtime_error("The mapped strategy needs --a-file and --b-file!");
+
+            const MappedVectorFile a_file(options.a_file);
+            const MappedVectorFile b_file(options.b_file);
+            if (a_file.size() != b_file.size())
+                throw std::runtime_error("Vector files " + options.a_file + " and " 
+                        + options.b_file + " differ in length!");
+
+            const uint64_t mapped_expected = select_dot_product_kernel()(a_file.data(), b_file.data(), a_file.size());
+
+            results.push_back(benchmark(strategy, 2, a_file.size(), mapped_expected, options, [&]() {
+                return mapped_dot_product(a_file, b_file, options.pipeline);
+            }));
+        } else if (strategy == PipelineStrategy::PARALLEL_REDUCTION) {
+            for (const unsigned int worker_count : options.worker_counts)
+                results.push_back(benchmark(strategy, worker_count, a_vec.size(), expected, options, [&]() {
+                    return run_pipeline(strategy, worker_count, a_vec, b_vec, options.pipeline);
+                }));
+        } else {
+            results.push_back(benchmark(strategy, 2, a_vec.size(), expected, options, [&]() {
+                return run_pipeline(strategy, 2, a_vec, b_vec, options.pipeline);
+            }));
+        }
+    }
+
+    return results;
+}
+
+int main(int argc, char** argv) {
+    try {
+        const BenchmarkOptions options = parse_options(argc, argv);
+        print_results(run_benchmarks(options), options.format);
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        print_usage(argv[0]);
+
+        return 1;
+    }
 
     return 0;
 }
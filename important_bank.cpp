@@ -1,5 +1,7 @@
-#include <memory>
 #include <cstdint>
+#include <vector>
+#include <string>
+#include <algorithm>
 #include <deque>
 #include <random>
 #include <thread>
@@ -7,245 +9,2172 @@
 #include <mutex>
 #include <stdexcept>
 #include <iostream>
-#include <unordered_map>
 #include <queue>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <limits>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <cstddef>
+#include <exception>
+#include <cmath>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 static constexpr unsigned int MAX_ACCOUNT_AMOUNT = 10000;
 static constexpr unsigned int MAX_TRANSFERRED_AMOUNT = 1000;
-static constexpr unsigned int WORKER_COUNT = 10;
+static constexpr unsigned int DEFAULT_WORKER_COUNT = 10;
 static constexpr unsigned int ACCOUNT_COUNT = 500;
 static constexpr unsigned int TRANSFER_COUNT = 10000;
 static constexpr unsigned int CHECKER_SLEEP_DURATION_NS = 100000;
+static constexpr std::size_t LOCAL_TRANSFER_BATCH = 32;
+
+static constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+enum class ExecutionMode { LOCKED_WORKERS, CONFLICT_FREE_BATCHES };
+enum class CheckerMode { LOCK_ALL, SNAPSHOT, INCREMENTAL };
+
+static constexpr ExecutionMode EXECUTION_MODE = ExecutionMode::CONFLICT_FREE_BATCHES;
+static constexpr unsigned int CHECKER_BATCH_INTERVAL = 16;
+
+static constexpr CheckerMode CHECKER_MODE = CheckerMode::INCREMENTAL;
+static constexpr unsigned int MAX_SNAPSHOT_RETRIES = 64;
+static constexpr unsigned int SNAPSHOT_TOTAL_INTERVAL = 10;
+
+static constexpr unsigned int DEFAULT_COMMIT_INTERVAL_US = 1000;
+static constexpr std::size_t DEFAULT_COMMIT_BATCH_RECORDS = 4096;
+static constexpr const char* DEFAULT_WAL_PATH = "bank.wal";
+
+static constexpr std::size_t DEFAULT_STREAM_TRANSFER_COUNT = 100000;
+static constexpr double DEFAULT_STREAM_RATE = 100000;
+static constexpr unsigned int DEFAULT_GENERATOR_COUNT = 2;
+static constexpr std::size_t DEFAULT_STREAM_QUEUE_CAPACITY = 1 << 12;
+static constexpr std::int64_t GENERATOR_SLEEP_THRESHOLD_NS = 100000;
+
+static constexpr double DEFAULT_ZIPF_EXPONENT = 1.1;
+static constexpr unsigned int DEFAULT_WHALE_COUNT = 4;
+static constexpr double DEFAULT_WHALE_FRACTION = 0.5;
+static constexpr double DEFAULT_SELF_TRANSFER_FRACTION = 0.25;
+
+enum class WorkloadProfile { UNIFORM, ZIPF, WHALES, SELF_TRANSFERS };
+
+// Seeded once per thread; seeding from random_device on every call made
+// setting up a large bank slower than running it.
+std::mt19937& thread_rng() {
+    thread_local std::mt19937 rng(std::random_device{}());
+
+    return rng;
+}
 
 int random_int(int lowerBound, int upperBound) {
-    std::random_device dev;
-    std::mt19937 rng(dev());
-    std::uniform_int_distribution<std::mt19937::result_type> dist(lowerBound, upperBound - 1);
+    std::uniform_int_distribution<int> dist(lowerBound, upperBound - 1);
 
-    return dist(rng);
+    return dist(thread_rng());
 }
 
-class Account {
-    public:
-        const std::uint32_t uid;
+std::int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+struct WorkloadOptions {
+    WorkloadProfile profile = WorkloadProfile::UNIFORM;
+    std::size_t account_count = ACCOUNT_COUNT;
+    std::size_t transfer_count = TRANSFER_COUNT;
+
+    double zipf_exponent = DEFAULT_ZIPF_EXPONENT;
+    // Whale transfers have a whale on one side and a random account on the other.
+    unsigned int whale_count = DEFAULT_WHALE_COUNT;
+    double whale_fraction = DEFAULT_WHALE_FRACTION;
+    double self_transfer_fraction = DEFAULT_SELF_TRANSFER_FRACTION;
+};
+
+const char* profile_name(WorkloadProfile profile) {
+    switch (profile) {
+        case WorkloadProfile::UNIFORM: return "uniform";
+        case WorkloadProfile::ZIPF: return "zipf";
+        case WorkloadProfile::WHALES: return "whales";
+        case WorkloadProfile::SELF_TRANSFERS: return "self";
+    }
+
+    return "unknown";
+}
 
-        unsigned int balance;
-        const unsigned int initial_balance; 
+WorkloadProfile parse_profile(const std::string& name) {
+    for (const WorkloadProfile profile : { WorkloadProfile::UNIFORM, WorkloadProfile::ZIPF, 
+            WorkloadProfile::WHALES, WorkloadProfile::SELF_TRANSFERS })
+        if (name == profile_name(profile))
+            return profile;
 
-        mutable std::mutex mutex;
-        std::vector<std::uint32_t> transfers_logged;
+    throw std::runtime_error("Unknown workload profile: " + name);
+}
 
-        Account(std::uint32_t uid, unsigned int balance) 
-            : uid(uid), balance(balance), initial_balance(balance) {}
+struct GeneratedTransfer {
+    unsigned int amount;
+    std::uint32_t payee_uid;
+    std::uint32_t payer_uid;
 };
 
-class Transfer {
+// Draws transfers for one workload profile. Distributions carry state, so
+// every thread owns its generator; the Zipf table is built once per thread.
+class TransferGenerator {
+    private:
+        const WorkloadOptions options;
+        std::mt19937 rng;
+
+        std::uniform_int_distribution<std::uint32_t> account_dist;
+        std::uniform_int_distribution<std::uint32_t> whale_dist;
+        std::uniform_int_distribution<unsigned int> amount_dist;
+        std::bernoulli_distribution choice_dist;
+        std::bernoulli_distribution side_dist;
+        std::discrete_distribution<std::uint32_t> zipf_dist;
+
+        static double _choice_probability(const WorkloadOptions& options) {
+            if (options.profile == WorkloadProfile::WHALES)
+                return options.whale_fraction;
+            if (options.profile == WorkloadProfile::SELF_TRANSFERS)
+                return options.self_transfer_fraction;
+
+            return 0;
+        }
+
+        // Account uid k is the (k + 1)-th most popular one.
+        static std::vector<double> _zipf_weights(const WorkloadOptions& options) {
+            std::vector<double> weights;
+            if (options.profile != WorkloadProfile::ZIPF)
+                return weights;
+
+            weights.reserve(options.account_count);
+            for (std::size_t rank = 1; rank <= options.account_count; rank++)
+                weights.push_back(1.0 / std::pow(double(rank), options.zipf_exponent));
+
+            return weights;
+        }
+
     public:
-        const std::uint32_t uid;
-        const unsigned int amount_transferred;
-        bool executed = false;
+        TransferGenerator(const WorkloadOptions& options, std::mt19937::result_type seed)
+            : options(options), rng(seed), account_dist(0, options.account_count - 1),
+            whale_dist(0, std::max(1u, std::min<unsigned int>(options.whale_count, options.account_count)) - 1),
+            amount_dist(0, MAX_TRANSFERRED_AMOUNT - 1), choice_dist(_choice_probability(options)),
+            side_dist(0.5) {
+            const std::vector<double> weights = _zipf_weights(options);
+            zipf_dist = std::discrete_distribution<std::uint32_t>(weights.begin(), weights.end());
+        }
 
-        const std::uint32_t payee_uid;
-        const std::uint32_t payer_uid;
+        GeneratedTransfer next() {
+            GeneratedTransfer transfer;
 
-        Transfer(std::uint32_t uid, 
-                 unsigned int amount_transferred, 
-                 std::shared_ptr<Account> payee, 
-                 std::shared_ptr<Account> payer) 
-            : uid(uid), amount_transferred(amount_transferred),
-            payee_uid(payee->uid), payer_uid(payer->uid), payee(payee), payer(payer) {}
+            if (options.profile == WorkloadProfile::ZIPF) {
+                transfer.payee_uid = zipf_dist(rng);
+                transfer.payer_uid = zipf_dist(rng);
+            } else {
+                transfer.payee_uid = account_dist(rng);
+                transfer.payer_uid = account_dist(rng);
 
-        void execute() {
-            if (executed)
-                throw std::runtime_error("Transaction with ID " + std::to_string(uid) + " already executed!");
+                if (choice_dist(rng)) {
+                    if (options.profile == WorkloadProfile::SELF_TRANSFERS)
+                        transfer.payer_uid = transfer.payee_uid;
+                    else if (side_dist(rng))
+                        transfer.payee_uid = whale_dist(rng);
+                    else
+                        transfer.payer_uid = whale_dist(rng);
+                }
+            }
 
-            executed = true;
+            transfer.amount = amount_dist(rng);
 
-            if (payee->uid == payer->uid)
-                return;
+            return transfer;
+        }
+};
+
+// Accounts touched since the checker last looked at them. Each account is
+// queued at most once per pass: only the worker that flips its flag pushes it.
+class DirtyAccountSet {
+    private:
+        std::vector<std::atomic<bool>> flags;
+
+        std::mutex mutex;
+        std::vector<std::uint32_t> dirty_uids;
 
-            std::scoped_lock lock(payee->mutex, payer->mutex);
+    public:
+        explicit DirtyAccountSet(std::size_t account_count) : flags(account_count) {}
 
-            if (payer->balance < amount_transferred)
+        void mark(std::uint32_t uid) {
+            if (flags[uid].load(std::memory_order_relaxed) || flags[uid].exchange(true, std::memory_order_acq_rel))
                 return;
 
-            payer->balance -= amount_transferred;
-            payer->transfers_logged.push_back(uid);
+            std::lock_guard<std::mutex> lock(mutex);
+            dirty_uids.push_back(uid);
+        }
+
+        std::vector<std::uint32_t> take() {
+            std::vector<std::uint32_t> taken;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            taken.swap(dirty_uids);
 
-            payee->balance += amount_transferred;
-            payee->transfers_logged.push_back(uid);
+            return taken;
         }
 
-    private:
-        const std::shared_ptr<Account> payee;
-        const std::shared_ptr<Account> payer;
+        // Must be called before the account's log is read, so a transfer
+        // logged after the read is guaranteed to queue the account again.
+        void clear(std::uint32_t uid) {
+            flags[uid].store(false, std::memory_order_release);
+        }
+};
+
+enum class WalRecordType : std::uint32_t { OPEN_ACCOUNT = 1, TRANSFER = 2 };
 
+// On-disk log record. OPEN_ACCOUNT records store the account uid in payer_uid
+// and its opening balance in amount.
+struct WalRecord {
+    WalRecordType type;
+    std::uint32_t transfer_uid;
+    std::uint32_t payer_uid;
+    std::uint32_t payee_uid;
+    unsigned int amount;
+    std::uint32_t checksum;
 };
 
-class TransferWorker {
-    private: 
-        std::vector<Transfer> transfers;
+static_assert(sizeof(WalRecord) == 24, "WAL records are read back with a fixed size");
+
+std::uint32_t wal_checksum(const WalRecord& record) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&record);
+
+    std::uint32_t hash = 2166136261u;
+    for (std::size_t index = 0; index < offsetof(WalRecord, checksum); index++)
+        hash = (hash ^ bytes[index]) * 16777619u;
+
+    return hash;
+}
+
+struct WalOptions {
+    std::string path;
+    unsigned int commit_interval_us = DEFAULT_COMMIT_INTERVAL_US;
+    std::size_t commit_batch_records = DEFAULT_COMMIT_BATCH_RECORDS;
+    bool sync_commit = false;
+    bool recover = false;
+};
+
+struct WalStats {
+    std::size_t commit_count = 0;
+    std::size_t record_count = 0;
+    std::vector<double> commit_latencies_us;
+};
+
+// Write-ahead log with group commit. Appenders only copy the record into the
+// pending buffer; a single flusher thread writes the whole buffer and issues
+// one fdatasync once commit_interval_us has passed since the oldest pending
+// record or commit_batch_records are pending, whichever comes first.
+//
+// A failed write or fdatasync stops the flusher and is kept rather than thrown
+// on its thread: waiters are woken, later appends are dropped, and
+// close_log() rethrows the error on the thread that closes the log.
+class WriteAheadLog {
+    private:
+        const WalOptions options;
+        int fd = -1;
+
+        std::mutex mutex;
+        std::condition_variable flush_condition;
+        std::condition_variable durable_condition;
+
+        std::vector<WalRecord> pending_records;
+        std::vector<std::chrono::steady_clock::time_point> pending_times;
+        std::uint64_t appended_lsn = 0;
+        std::uint64_t durable_lsn = 0;
+        bool stopping = false;
+        std::exception_ptr failure;
+
+        WalStats stats;
+        std::thread flusher_thread;
+
+        void _write_all(const std::vector<WalRecord>& records) {
+            const char* data = reinterpret_cast<const char*>(records.data());
+            std::size_t remaining = records.size() * sizeof(WalRecord);
+
+            while (remaining > 0) {
+                const ssize_t written = write(fd, data, remaining);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written < 0)
+                    throw std::runtime_error(std::string("WAL write failed: ") + std::strerror(errno));
+
+                data += written;
+                remaining -= written;
+            }
+
+            if (fdatasync(fd) < 0)
+                throw std::runtime_error(std::string("WAL fdatasync failed: ") + std::strerror(errno));
+        }
+
+        void _run_flusher() {
+            const auto commit_interval = std::chrono::microseconds(options.commit_interval_us);
+
+            std::vector<WalRecord> records;
+            std::vector<std::chrono::steady_clock::time_point> append_times;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            for (;;) {
+                flush_condition.wait(lock, [this]() { return stopping || !pending_records.empty(); });
+                if (pending_records.empty())
+                    return;
+
+                const auto deadline = pending_times.front() + commit_interval;
+                flush_condition.wait_until(lock, deadline, [this]() {
+                    return stopping || pending_records.size() >= options.commit_batch_records;
+                });
+
+                records.swap(pending_records);
+                append_times.swap(pending_times);
+                const std::uint64_t batch_lsn = appended_lsn;
+
+                lock.unlock();
+                try {
+                    _write_all(records);
+                } catch (...) {
+                    lock.lock();
+                    failure = std::current_exception();
+                    durable_condition.notify_all();
+                    return;
+                }
+                const auto commit_time = std::chrono::steady_clock::now();
+                lock.lock();
+
+                durable_lsn = batch_lsn;
+                durable_condition.notify_all();
+
+                stats.commit_count++;
+                stats.record_count += records.size();
+                for (const auto& append_time : append_times)
+                    stats.commit_latencies_us.push_back(
+                            std::chrono::duration<double, std::micro>(commit_time - append_time).count());
+
+                records.clear();
+                append_times.clear();
+            }
+        }
+
+        void _stop() {
+            if (fd < 0)
+                return;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+                flush_condition.notify_one();
+            }
+
+            flusher_thread.join();
+            close(fd);
+            fd = -1;
+        }
 
     public:
-        TransferWorker(std::vector<Transfer>& transfers) 
-            : transfers(transfers) {}
+        explicit WriteAheadLog(const WalOptions& options) : options(options) {
+            const int truncate_flag = options.recover ? 0 : O_TRUNC;
+            fd = open(options.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | truncate_flag, 0644);
+            if (fd < 0)
+                throw std::runtime_error("Cannot open WAL " + options.path + ": " + std::strerror(errno));
+
+            // A torn tail would hide every record appended after it from the
+            // next recovery, so appends resume right after the last intact one.
+            if (options.recover) {
+                const off_t intact_size = static_cast<off_t>(read_records(options.path).size() * sizeof(WalRecord));
+                if (ftruncate(fd, intact_size) != 0 || fsync(fd) != 0)
+                    throw std::runtime_error("Cannot truncate WAL " + options.path + ": " + std::strerror(errno));
+            }
 
-        void add_transfer(Transfer& transfer) {
-            transfers.push_back(transfer);
+            flusher_thread = std::thread(&WriteAheadLog::_run_flusher, this);
         }
 
-        void run() {
-            for (auto &transfer : transfers)
-                transfer.execute();
+        WriteAheadLog(const WriteAheadLog&) = delete;
+        WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+        ~WriteAheadLog() {
+            _stop();
+        }
+
+        // Returns the record's log sequence number, to be passed to wait_durable.
+        std::uint64_t append(WalRecord record) {
+            record.checksum = wal_checksum(record);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (failure)
+                return ++appended_lsn;
+
+            pending_records.push_back(record);
+            pending_times.push_back(std::chrono::steady_clock::now());
+
+            if (pending_records.size() == 1 || pending_records.size() == options.commit_batch_records)
+                flush_condition.notify_one();
+
+            return ++appended_lsn;
+        }
+
+        void wait_durable(std::uint64_t lsn) {
+            std::unique_lock<std::mutex> lock(mutex);
+            durable_condition.wait(lock, [this, lsn]() { return durable_lsn >= lsn || failure; });
+        }
+
+        bool sync_commit() const {
+            return options.sync_commit;
+        }
+
+        // Flushes everything still pending and stops the flusher; throws if
+        // any commit failed.
+        void close_log() {
+            _stop();
+
+            if (failure)
+                std::rethrow_exception(failure);
+        }
+
+        const WalStats& get_stats() const {
+            return stats;
+        }
+
+        // Reads back every intact record. Replay stops at the first torn or
+        // corrupted record, which can only be the tail of an interrupted commit.
+        static std::vector<WalRecord> read_records(const std::string& path) {
+            std::vector<WalRecord> records;
+            std::ifstream file(path, std::ios::binary);
+
+            WalRecord record;
+            while (file.read(reinterpret_cast<char*>(&record), sizeof(WalRecord))) {
+                if (record.checksum != wal_checksum(record))
+                    break;
+
+                records.push_back(record);
+            }
+
+            return records;
         }
 };
 
-class ConsistencyChecker {
+typedef std::uint32_t JournalRef;
+
+static constexpr JournalRef NO_JOURNAL_RECORD = std::numeric_limits<JournalRef>::max();
+static constexpr std::size_t JOURNAL_BLOCK_RECORDS = 1 << 12;
+
+// One executed transfer. Every record sits in the history of both its payer
+// and its payee; the previous_* links chain each account's history backwards
+// and the sequences give the record's 1-based position in those histories.
+struct JournalRecord {
+    std::uint32_t transfer_uid;
+    std::uint32_t payer_uid;
+    std::uint32_t payee_uid;
+    unsigned int amount;
+
+    std::uint32_t payer_sequence;
+    std::uint32_t payee_sequence;
+    JournalRef previous_payer_record;
+    JournalRef previous_payee_record;
+};
+
+static_assert(sizeof(JournalRecord) == 32, "Journal records should stay half a cache line");
+
+// Fixed-capacity arena of journal blocks. Whole blocks are handed out to
+// per-worker journals, so records get global 32-bit refs while appends never
+// contend; the block table never moves, so readers need no extra locking.
+class JournalArena {
     private:
-        const std::unordered_map<std::uint32_t, std::shared_ptr<Account>>& accounts;
-        const std::unordered_map<std::uint32_t, Transfer>& transfers;
-        std::atomic<bool>& running;
+        std::size_t max_block_count = 0;
+        std::unique_ptr<std::unique_ptr<JournalRecord[]>[]> blocks;
+        std::atomic<std::size_t> next_block{0};
 
-    public:
-        ConsistencyChecker(const std::unordered_map<std::uint32_t, std::shared_ptr<Account>>& accounts,
-                           const std::unordered_map<std::uint32_t, Transfer>& transfers,
-                           std::atomic<bool>& running)
-            : accounts(accounts), transfers(transfers), running(running) {}
+        WriteAheadLog* wal = nullptr;
 
-        unsigned int check_account(const Account& account) const {
-            auto& transfers_logged = account.transfers_logged;
-            unsigned int account_balance = account.balance;
+    public:
+        // Must be called before any journal appends; reserves the block table
+        // only, blocks themselves are allocated when first handed out.
+        void reserve(std::size_t record_capacity) {
+            max_block_count = (record_capacity + JOURNAL_BLOCK_RECORDS - 1) / JOURNAL_BLOCK_RECORDS;
+            if (max_block_count * JOURNAL_BLOCK_RECORDS > NO_JOURNAL_RECORD)
+                throw std::runtime_error("Journal capacity exceeds 32-bit record refs!");
 
-            unsigned int expected_balance = account.initial_balance;
-            for (const std::uint32_t transfer_uid : transfers_logged) {
-                const Transfer& transfer = transfers.at(transfer_uid);
+            blocks.reset(new std::unique_ptr<JournalRecord[]>[max_block_count]);
+            next_block = 0;
+        }
 
-                if (transfer.payee_uid == account.uid)
-                    expected_balance += transfers.at(transfer_uid).amount_transferred;
-                else if (transfer.payer_uid == account.uid)
-                    expected_balance -= transfers.at(transfer_uid).amount_transferred;
-                else
-                    throw std::runtime_error("Logged transfer is not related to account!");
-            }
+        std::size_t acquire_block() {
+            const std::size_t block_index = next_block.fetch_add(1, std::memory_order_relaxed);
+            if (block_index >= max_block_count)
+                throw std::runtime_error("Transfer journal is full!");
 
-            if (expected_balance != account_balance)
-                throw std::runtime_error("Account balance is different from expected balance!");
+            blocks[block_index].reset(new JournalRecord[JOURNAL_BLOCK_RECORDS]);
 
-            return expected_balance;
+            return block_index;
         }
 
-        void run() const {
-            const auto wait_duration = std::chrono::nanoseconds(CHECKER_SLEEP_DURATION_NS);
-            unsigned int bank_total_balance = 0;
-            unsigned int expected_total_balance = 0;
+        JournalRecord& record(JournalRef ref) {
+            return blocks[ref / JOURNAL_BLOCK_RECORDS][ref % JOURNAL_BLOCK_RECORDS];
+        }
 
-            while (running) {
-                for (const auto& [uid, account] : accounts)
-                    account->mutex.lock();
+        const JournalRecord& record(JournalRef ref) const {
+            return blocks[ref / JOURNAL_BLOCK_RECORDS][ref % JOURNAL_BLOCK_RECORDS];
+        }
 
-                for (const auto& [uid, account] : accounts) {
-                    unsigned int expected_balance = check_account(*account);
+        // Every record appended after this is also made durable through wal.
+        void attach_wal(WriteAheadLog* wal) {
+            this->wal = wal;
+        }
 
-                    bank_total_balance += account->balance;
-                    expected_total_balance += expected_balance;
-                }
+        WriteAheadLog* get_wal() const {
+            return wal;
+        }
 
-                for (const auto& [uid, account] : accounts)
-                    account->mutex.unlock();
+        std::size_t allocated_bytes() const {
+            return std::min(next_block.load(), max_block_count) * JOURNAL_BLOCK_RECORDS * sizeof(JournalRecord);
+        }
+};
 
-                if (bank_total_balance != expected_total_balance)
-                    throw std::runtime_error("Bank total balance is differented form expected balance!");
+// Append-only journal owned by a single worker thread.
+class TransferJournal {
+    private:
+        JournalArena* arena;
+        std::size_t block_index = 0;
+        std::size_t next_offset = JOURNAL_BLOCK_RECORDS;
+        std::uint64_t last_lsn = 0;
 
-                std::cout << "Consistency check succeeded!" << std::endl;
+    public:
+        explicit TransferJournal(JournalArena& arena) : arena(&arena) {}
 
-                std::this_thread::sleep_for(wait_duration);
+        JournalRef append(const JournalRecord& record) {
+            if (next_offset == JOURNAL_BLOCK_RECORDS) {
+                block_index = arena->acquire_block();
+                next_offset = 0;
             }
+
+            const JournalRef ref = block_index * JOURNAL_BLOCK_RECORDS + next_offset++;
+            arena->record(ref) = record;
+
+            if (WriteAheadLog* wal = arena->get_wal())
+                last_lsn = wal->append({ WalRecordType::TRANSFER, record.transfer_uid, 
+                        record.payer_uid, record.payee_uid, record.amount, 0 });
+
+            return ref;
+        }
+
+        // With synchronous commit, blocks until everything this journal has
+        // appended is durable. Call it outside account locks, once per batch
+        // of transfers, so the wait is shared by the whole batch.
+        void sync() {
+            WriteAheadLog* wal = arena->get_wal();
+
+            if (wal && wal->sync_commit() && last_lsn)
+                wal->wait_durable(last_lsn);
         }
 };
 
-class Bank {
-    std::unordered_map<std::uint32_t, std::shared_ptr<Account>> accounts;
-    std::unordered_map<std::uint32_t, Transfer> transfers;
-    std::atomic<bool> run_checker;
+// Accounts are addressed by their dense uid. Everything a transfer touches
+// (lock, version, balance and the head and length of the account's journal
+// chain) lives in one cache-line sized slot per account, so two accounts
+// never share a line. Only the initial balances, read by the checker, are
+// kept apart.
+//
+// The version is a seqlock counter: writers make it odd for the duration of
+// an update, which lets readers take lock-free snapshots of the balances.
+class AccountTable {
+    private:
+        struct alignas(CACHE_LINE_SIZE) HotSlot {
+            mutable std::mutex mutex;
+            std::atomic<std::uint32_t> version{0};
+            std::atomic<unsigned int> balance{0};
+            JournalRef log_head = NO_JOURNAL_RECORD;
+            std::uint32_t log_length = 0;
+        };
 
-    std::vector<TransferWorker> workers;
-    ConsistencyChecker consistency_checker;
+        static_assert(sizeof(HotSlot) == CACHE_LINE_SIZE, "An account's hot data should fill exactly one cache line");
 
-    void _create_accounts(unsigned int account_count,
-                          unsigned int max_amount) {
-        for (std::uint32_t uid = 0; uid < account_count; uid++)
-            accounts[uid] = std::make_shared<Account>(uid, random_int(0, max_amount));
-    }
+        std::vector<HotSlot> hot_slots;
+        std::vector<unsigned int> initial_balances;
 
-    void _create_transfers(unsigned int transfer_count,
-                           unsigned int max_transferred_amount) {
-        for (std::uint32_t uid = 0; uid < transfer_count; uid++) {
-            std::uint32_t payee_uid = random_int(0, accounts.size());
-            std::uint32_t payer_uid = random_int(0, accounts.size());
+        DirtyAccountSet dirty_set;
+
+    public:
+        explicit AccountTable(std::size_t account_count)
+            : hot_slots(account_count), initial_balances(account_count, 0), dirty_set(account_count) {}
 
-            int amount = random_int(0, max_transferred_amount);
+        std::size_t size() const {
+            return hot_slots.size();
+        }
 
-            transfers.insert(std::make_pair(uid, 
-                        Transfer(uid, amount, accounts[payee_uid], accounts[payer_uid])));
+        void open_account(std::uint32_t uid, unsigned int balance) {
+            hot_slots[uid].balance.store(balance, std::memory_order_relaxed);
+            initial_balances[uid] = balance;
+        }
+
+        std::mutex& mutex(std::uint32_t uid) const {
+            return hot_slots[uid].mutex;
         }
-    }
 
-    void _assign_transfers_to_workers() {
-        workers.reserve(WORKER_COUNT);
-        unsigned int transfers_per_worker = transfers.size() / WORKER_COUNT;
+        unsigned int balance(std::uint32_t uid) const {
+            return hot_slots[uid].balance.load(std::memory_order_relaxed);
+        }
 
-        for (unsigned int transfer_batch_index = 0; 
-                transfer_batch_index < WORKER_COUNT; transfer_batch_index++) {
-            std::uint32_t start_batch_uid = transfer_batch_index * transfers_per_worker;
+        void set_balance(std::uint32_t uid, unsigned int balance) {
+            hot_slots[uid].balance.store(balance, std::memory_order_relaxed);
+        }
 
-            std::vector<Transfer> transfer_batch;
-            transfer_batch.reserve(transfers_per_worker);
-            for (std::uint32_t transfer_uid = start_batch_uid; 
-                    transfer_uid < transfers.size(); transfer_uid++)
-                transfer_batch.push_back(transfers.at(transfer_uid));
+        // Writers must be exclusive on the account (lock held or conflict-free
+        // batch) between begin_update and end_update.
+        void begin_update(std::uint32_t uid) {
+            auto& version = hot_slots[uid].version;
 
-            workers.emplace_back(transfer_batch);
+            version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
         }
-    }
 
+        void end_update(std::uint32_t uid) {
+            auto& version = hot_slots[uid].version;
+
+            version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        std::uint32_t version(std::uint32_t uid, std::memory_order order = std::memory_order_acquire) const {
+            return hot_slots[uid].version.load(order);
+        }
+
+        unsigned int initial_balance(std::uint32_t uid) const {
+            return initial_balances[uid];
+        }
+
+        JournalRef log_head(std::uint32_t uid) const {
+            return hot_slots[uid].log_head;
+        }
+
+        std::uint32_t log_length(std::uint32_t uid) const {
+            return hot_slots[uid].log_length;
+        }
+
+        void link_log(std::uint32_t uid, JournalRef ref) {
+            hot_slots[uid].log_head = ref;
+            hot_slots[uid].log_length++;
+        }
+
+        DirtyAccountSet& dirty_accounts() {
+            return dirty_set;
+        }
+};
+
+class Transfer {
     public:
-        Bank() : consistency_checker(accounts, transfers, run_checker) {}
+        const std::uint32_t uid;
+        const unsigned int amount_transferred;
+        bool executed = false;
 
-        void prepare_bank() {
-            _create_accounts(ACCOUNT_COUNT, MAX_ACCOUNT_AMOUNT);
-            _create_transfers(TRANSFER_COUNT, MAX_TRANSFERRED_AMOUNT);
-            _assign_transfers_to_workers();
+        const std::uint32_t payee_uid;
+        const std::uint32_t payer_uid;
+
+        Transfer(std::uint32_t uid, 
+                 unsigned int amount_transferred, 
+                 std::uint32_t payee_uid, 
+                 std::uint32_t payer_uid) 
+            : uid(uid), amount_transferred(amount_transferred),
+            payee_uid(payee_uid), payer_uid(payer_uid) {}
+
+        // Returns the nanoseconds spent blocked on the account locks; the
+        // clock is only read when the first attempt finds them contended.
+        std::int64_t execute(AccountTable& accounts, TransferJournal& journal) {
+            _mark_executed();
+
+            if (payee_uid == payer_uid)
+                return 0;
+
+            std::unique_lock<std::mutex> payee_lock(accounts.mutex(payee_uid), std::defer_lock);
+            std::unique_lock<std::mutex> payer_lock(accounts.mutex(payer_uid), std::defer_lock);
+
+            std::int64_t lock_wait_ns = 0;
+            if (std::try_lock(payee_lock, payer_lock) != -1) {
+                const std::int64_t wait_start_ns = now_ns();
+                std::lock(payee_lock, payer_lock);
+                lock_wait_ns = std::max<std::int64_t>(now_ns() - wait_start_ns, 1);
+            }
+
+            _apply(accounts, journal);
+
+            return lock_wait_ns;
         }
 
-        void open_bank() {
-            auto t_start = std::chrono::high_resolution_clock::now();
+        // Only safe when no other thread can touch payee or payer concurrently,
+        // i.e. inside a conflict-free batch.
+        void execute_unlocked(AccountTable& accounts, TransferJournal& journal) {
+            _mark_executed();
 
-            std::deque<std::thread> worker_threads;
-            for (auto &worker : workers)
-                worker_threads.emplace_back(&TransferWorker::run, worker);
+            if (payee_uid == payer_uid)
+                return;
 
-            run_checker = true;
-            std::thread checker_thread(&ConsistencyChecker::run, consistency_checker);
+            _apply(accounts, journal);
+        }
 
-            for (auto &thread : worker_threads)
-                thread.join();
+    private:
+        void _mark_executed() {
+            if (executed)
+                throw std::runtime_error("Transaction with ID " + std::to_string(uid) + " already executed!");
 
-            const auto wait_duration = std::chrono::nanoseconds(CHECKER_SLEEP_DURATION_NS);
-            std::this_thread::sleep_for(wait_duration);
+            executed = true;
+        }
 
-            run_checker = false;
-            checker_thread.join();
+        // Both versions are made odd before either balance changes, so a
+        // snapshot reader can never observe only one half of the transfer.
+        void _apply(AccountTable& accounts, TransferJournal& journal) {
+            const unsigned int payer_balance = accounts.balance(payer_uid);
+            if (payer_balance < amount_transferred)
+                return;
 
-            auto t_end = std::chrono::high_resolution_clock::now();
-            double elapsed_time_ms = std::chrono::duration<double, std::milli>(t_end-t_start).count();
+            const JournalRef record_ref = journal.append({ uid, payer_uid, payee_uid, amount_transferred,
+                    accounts.log_length(payer_uid) + 1, accounts.log_length(payee_uid) + 1,
+                    accounts.log_head(payer_uid), accounts.log_head(payee_uid) });
 
-            std::cout << "Bank closed after " << elapsed_time_ms << "ms" << std::endl;
+            accounts.begin_update(payer_uid);
+            accounts.begin_update(payee_uid);
+
+            accounts.set_balance(payer_uid, payer_balance - amount_transferred);
+            accounts.link_log(payer_uid, record_ref);
+
+            accounts.set_balance(payee_uid, accounts.balance(payee_uid) + amount_transferred);
+            accounts.link_log(payee_uid, record_ref);
+
+            accounts.end_update(payee_uid);
+            accounts.end_update(payer_uid);
+
+            accounts.dirty_accounts().mark(payer_uid);
+            accounts.dirty_accounts().mark(payee_uid);
         }
 };
 
-int main() {
-    Bank bank;
+struct LockWaitStats {
+    std::int64_t wait_ns = 0;
+    std::size_t contended_count = 0;
+
+    void record(std::int64_t lock_wait_ns) {
+        if (lock_wait_ns == 0)
+            return;
+
+        wait_ns += lock_wait_ns;
+        contended_count++;
+    }
+
+    void merge(const LockWaitStats& other) {
+        wait_ns += other.wait_ns;
+        contended_count += other.contended_count;
+    }
+};
+
+// Per-worker deque of transfer indices. The owner takes small batches from
+// the back, thieves take half of what is left from the front.
+class TransferWorker {
+    private:
+        std::mutex mutex;
+        std::deque<std::uint32_t> transfer_uids;
+
+    public:
+        TransferJournal journal;
+        std::size_t steal_count = 0;
+        LockWaitStats lock_waits;
+
+        explicit TransferWorker(JournalArena& arena) : journal(arena) {}
+
+        void push(std::uint32_t transfer_uid) {
+            std::lock_guard<std::mutex> lock(mutex);
+            transfer_uids.push_back(transfer_uid);
+        }
+
+        std::size_t pop_batch(std::vector<std::uint32_t>& batch, std::size_t max_count) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            const std::size_t count = std::min(max_count, transfer_uids.size());
+            for (std::size_t index = 0; index < count; index++) {
+                batch.push_back(transfer_uids.back());
+                transfer_uids.pop_back();
+            }
+
+            return count;
+        }
+
+        std::size_t steal_half(std::vector<std::uint32_t>& batch) {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            const std::size_t count = (transfer_uids.size() + 1) / 2;
+            for (std::size_t index = 0; index < count; index++) {
+                batch.push_back(transfer_uids.front());
+                transfer_uids.pop_front();
+            }
+
+            return count;
+        }
+};
+
+// Executes every transfer exactly once under per-account locks. Workers start
+// with equal contiguous slices and steal from each other once they run dry,
+// so a worker stuck behind hot accounts does not hold up the rest. No work is
+// ever added after start, so a worker that finds every deque empty can stop.
+class WorkStealingExecutor {
+    private:
+        std::vector<Transfer>& transfers;
+        AccountTable& accounts;
+
+        std::vector<std::unique_ptr<TransferWorker>> workers;
+
+        bool _steal(unsigned int thief_index, std::vector<std::uint32_t>& batch) {
+            for (unsigned int offset = 1; offset < workers.size(); offset++) {
+                TransferWorker& victim = *workers[(thief_index + offset) % workers.size()];
+
+                if (victim.steal_half(batch)) {
+                    workers[thief_index]->steal_count++;
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        void _run_worker(unsigned int worker_index) {
+            TransferWorker& worker = *workers[worker_index];
+
+            std::vector<std::uint32_t> batch;
+            batch.reserve(LOCAL_TRANSFER_BATCH);
+
+            for (;;) {
+                if (!worker.pop_batch(batch, LOCAL_TRANSFER_BATCH) && !_steal(worker_index, batch))
+                    return;
+
+                for (const std::uint32_t transfer_uid : batch)
+                    worker.lock_waits.record(transfers[transfer_uid].execute(accounts, worker.journal));
+
+                worker.journal.sync();
+                batch.clear();
+            }
+        }
+
+    public:
+        WorkStealingExecutor(std::vector<Transfer>& transfers,
+                             AccountTable& accounts,
+                             JournalArena& journal_arena,
+                             unsigned int worker_count)
+            : transfers(transfers), accounts(accounts) {
+            for (unsigned int worker_index = 0; worker_index < worker_count; worker_index++)
+                workers.push_back(std::make_unique<TransferWorker>(journal_arena));
+
+            const std::size_t transfers_per_worker = transfers.size() / worker_count;
+            const std::size_t remainder = transfers.size() % worker_count;
+
+            std::uint32_t transfer_uid = 0;
+            for (unsigned int worker_index = 0; worker_index < worker_count; worker_index++) {
+                const std::size_t slice_size = transfers_per_worker + (worker_index < remainder ? 1 : 0);
+
+                for (std::size_t index = 0; index < slice_size; index++)
+                    workers[worker_index]->push(transfer_uid++);
+            }
+        }
+
+        void run() {
+            std::deque<std::thread> worker_threads;
+            for (unsigned int worker_index = 0; worker_index < workers.size(); worker_index++)
+                worker_threads.emplace_back(&WorkStealingExecutor::_run_worker, this, worker_index);
+
+            for (auto &thread : worker_threads)
+                thread.join();
+        }
+
+        std::size_t steal_count() const {
+            std::size_t steals = 0;
+            for (const auto& worker : workers)
+                steals += worker->steal_count;
+
+            return steals;
+        }
+
+        LockWaitStats lock_waits() const {
+            LockWaitStats stats;
+            for (const auto& worker : workers)
+                stats.merge(worker->lock_waits);
+
+            return stats;
+        }
+};
+
+// Bounded multi-producer multi-consumer ring (Vyukov). Each cell carries a
+// sequence number telling producers and consumers whose turn it is, so the
+// only shared writes are one CAS on the enqueue or dequeue position.
+template <typename T>
+class BoundedMpmcQueue {
+    private:
+        struct alignas(CACHE_LINE_SIZE) Cell {
+            std::atomic<std::size_t> sequence;
+            T value;
+        };
+
+        std::unique_ptr<Cell[]> cells;
+        const std::size_t mask;
+
+        alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> enqueue_position{0};
+        alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> dequeue_position{0};
+        alignas(CACHE_LINE_SIZE) std::atomic<bool> closed{false};
+
+    public:
+        explicit BoundedMpmcQueue(std::size_t capacity) : cells(new Cell[capacity]), mask(capacity - 1) {
+            if (capacity < 2 || (capacity & mask) != 0)
+                throw std::runtime_error("Queue capacity must be a power of two!");
+
+            for (std::size_t index = 0; index < capacity; index++)
+                cells[index].sequence.store(index, std::memory_order_relaxed);
+        }
+
+        bool try_push(const T& value) {
+            std::size_t position = enqueue_position.load(std::memory_order_relaxed);
+
+            for (;;) {
+                Cell& cell = cells[position & mask];
+                const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const std::intptr_t difference = std::intptr_t(sequence) - std::intptr_t(position);
+
+                if (difference == 0) {
+                    if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        cell.value = value;
+                        cell.sequence.store(position + 1, std::memory_order_release);
+
+                        return true;
+                    }
+                } else if (difference < 0)
+                    return false;
+                else
+                    position = enqueue_position.load(std::memory_order_relaxed);
+            }
+        }
+
+        bool try_pop(T& value) {
+            std::size_t position = dequeue_position.load(std::memory_order_relaxed);
+
+            for (;;) {
+                Cell& cell = cells[position & mask];
+                const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const std::intptr_t difference = std::intptr_t(sequence) - std::intptr_t(position + 1);
+
+                if (difference == 0) {
+                    if (dequeue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        value = cell.value;
+                        cell.sequence.store(position + mask + 1, std::memory_order_release);
+
+                        return true;
+                    }
+                } else if (difference < 0)
+                    return false;
+                else
+                    position = dequeue_position.load(std::memory_order_relaxed);
+            }
+        }
+
+        // Waits for a value; returns false once the queue is closed and empty.
+        bool pop(T& value) {
+            for (;;) {
+                if (try_pop(value))
+                    return true;
+
+                if (closed.load(std::memory_order_acquire))
+                    return try_pop(value);
+
+                std::this_thread::yield();
+            }
+        }
+
+        // Producers must have finished pushing.
+        void close() {
+            closed.store(true, std::memory_order_release);
+        }
+};
+
+// HDR-style log-linear histogram: values below SUB_BUCKETS are exact, larger
+// values keep their top SIGNIFICANT_BITS bits, which bounds the relative
+// error to about 3% over the whole 64-bit range in a fixed 15KB table.
+class LatencyHistogram {
+    private:
+        static constexpr unsigned int SIGNIFICANT_BITS = 6;
+        static constexpr std::uint64_t SUB_BUCKETS = 1ull << SIGNIFICANT_BITS;
+        static constexpr std::uint64_t HALF_SUB_BUCKETS = SUB_BUCKETS / 2;
+        static constexpr std::size_t BUCKET_COUNT = SUB_BUCKETS + (64 - SIGNIFICANT_BITS) * HALF_SUB_BUCKETS;
+
+        std::vector<std::uint64_t> counts;
+        std::uint64_t total_count = 0;
+        std::uint64_t max_value = 0;
+
+        static std::size_t _bucket_index(std::uint64_t value) {
+            if (value < SUB_BUCKETS)
+                return value;
+
+            const unsigned int magnitude = 63 - __builtin_clzll(value);
+            const unsigned int shift = magnitude - (SIGNIFICANT_BITS - 1);
+
+            return SUB_BUCKETS + (magnitude - SIGNIFICANT_BITS) * HALF_SUB_BUCKETS 
+                + ((value >> shift) - HALF_SUB_BUCKETS);
+        }
+
+        // Largest value that falls into the bucket.
+        static std::uint64_t _bucket_value(std::size_t index) {
+            if (index < SUB_BUCKETS)
+                return index;
+
+            const unsigned int magnitude = SIGNIFICANT_BITS + (index - SUB_BUCKETS) / HALF_SUB_BUCKETS;
+            const unsigned int shift = magnitude - (SIGNIFICANT_BITS - 1);
+            const std::uint64_t top_bits = HALF_SUB_BUCKETS + (index - SUB_BUCKETS) % HALF_SUB_BUCKETS;
+
+            return ((top_bits + 1) << shift) - 1;
+        }
+
+    public:
+        LatencyHistogram() : counts(BUCKET_COUNT, 0) {}
+
+        void record(std::int64_t value) {
+            const std::uint64_t clamped = std::max<std::int64_t>(value, 0);
+
+            counts[_bucket_index(clamped)]++;
+            total_count++;
+            max_value = std::max(max_value, clamped);
+        }
+
+        void merge(const LatencyHistogram& other) {
+            for (std::size_t index = 0; index < BUCKET_COUNT; index++)
+                counts[index] += other.counts[index];
+
+            total_count += other.total_count;
+            max_value = std::max(max_value, other.max_value);
+        }
+
+        std::uint64_t count() const {
+            return total_count;
+        }
+
+        std::uint64_t max() const {
+            return max_value;
+        }
+
+        std::uint64_t value_at(double quantile) const {
+            if (total_count == 0)
+                return 0;
+
+            const std::uint64_t rank = std::max<std::uint64_t>(std::ceil(quantile * total_count), 1);
+
+            std::uint64_t seen = 0;
+            for (std::size_t index = 0; index < BUCKET_COUNT; index++) {
+                seen += counts[index];
+                if (seen >= rank)
+                    return std::min(_bucket_value(index), max_value);
+            }
+
+            return max_value;
+        }
+};
+
+struct StreamOptions {
+    std::size_t transfer_count = DEFAULT_STREAM_TRANSFER_COUNT;
+    // Transfers per second over all generators; 0 submits as fast as possible.
+    double target_rate = DEFAULT_STREAM_RATE;
+    unsigned int generator_count = DEFAULT_GENERATOR_COUNT;
+    std::size_t queue_capacity = DEFAULT_STREAM_QUEUE_CAPACITY;
+};
+
+struct StreamedTransfer {
+    std::uint32_t uid;
+    GeneratedTransfer transfer;
+    std::int64_t scheduled_ns;
+};
+
+struct StreamStats {
+    LatencyHistogram queue_latency;
+    LatencyHistogram execution_latency;
+    LockWaitStats lock_waits;
+    std::size_t full_queue_stalls = 0;
+    double elapsed_ms = 0;
+};
+
+// Open-loop transfer stream. Generators submit on a fixed schedule no matter
+// how fast workers drain the queue, and queueing latency is measured from the
+// scheduled time, so a backlog shows up in the histogram instead of silently
+// slowing the generators down. Execution latency runs from dequeue until the
+// transfer is applied (and durable, with synchronous WAL commits).
+class StreamingExecutor {
+    private:
+        struct StreamWorker {
+            TransferJournal journal;
+            LatencyHistogram queue_latency;
+            LatencyHistogram execution_latency;
+            LockWaitStats lock_waits;
+            std::int64_t last_completion_ns = 0;
+
+            explicit StreamWorker(JournalArena& arena) : journal(arena) {}
+        };
+
+        AccountTable& accounts;
+        const StreamOptions options;
+        const WorkloadOptions workload;
+
+        BoundedMpmcQueue<StreamedTransfer> queue;
+        std::vector<std::unique_ptr<StreamWorker>> workers;
+        std::vector<std::size_t> generator_stalls;
+
+        std::int64_t start_ns = 0;
+
+        static void _wait_until(std::int64_t deadline_ns) {
+            for (std::int64_t remaining_ns = deadline_ns - now_ns(); remaining_ns > 0; 
+                    remaining_ns = deadline_ns - now_ns()) {
+                if (remaining_ns > GENERATOR_SLEEP_THRESHOLD_NS)
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(remaining_ns));
+                else
+                    std::this_thread::yield();
+            }
+        }
+
+        void _run_generator(unsigned int generator_index) {
+            TransferGenerator generator(workload, std::random_device{}());
+
+            const unsigned int generator_count = options.generator_count;
+            const std::size_t first_uid = options.transfer_count * generator_index / generator_count;
+            const std::size_t end_uid = options.transfer_count * (generator_index + 1) / generator_count;
+
+            // Generators are staggered so the merged stream stays evenly spaced.
+            const double interval_ns = options.target_rate > 0 ? 1e9 * generator_count / options.target_rate : 0;
+            const double offset_ns = interval_ns * generator_index / generator_count;
+
+            for (std::size_t uid = first_uid; uid < end_uid; uid++) {
+                std::int64_t scheduled_ns = now_ns();
+                if (interval_ns > 0) {
+                    scheduled_ns = start_ns + std::int64_t(offset_ns + (uid - first_uid) * interval_ns);
+                    _wait_until(scheduled_ns);
+                }
+
+                const StreamedTransfer transfer{ std::uint32_t(uid), generator.next(), scheduled_ns };
+
+                while (!queue.try_push(transfer)) {
+                    generator_stalls[generator_index]++;
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        void _run_worker(unsigned int worker_index) {
+            StreamWorker& worker = *workers[worker_index];
+
+            std::vector<std::pair<StreamedTransfer, std::int64_t>> batch;
+            batch.reserve(LOCAL_TRANSFER_BATCH);
+
+            StreamedTransfer streamed;
+            while (queue.pop(streamed)) {
+                do {
+                    const std::int64_t dequeued_ns = now_ns();
+
+                    worker.queue_latency.record(dequeued_ns - streamed.scheduled_ns);
+                    batch.emplace_back(streamed, dequeued_ns);
+                } while (batch.size() < LOCAL_TRANSFER_BATCH && queue.try_pop(streamed));
+
+                for (const auto& [item, dequeued_ns] : batch) {
+                    Transfer transfer(item.uid, item.transfer.amount, item.transfer.payee_uid, item.transfer.payer_uid);
+                    worker.lock_waits.record(transfer.execute(accounts, worker.journal));
+                }
+
+                worker.journal.sync();
+
+                const std::int64_t completed_ns = now_ns();
+                for (const auto& [item, dequeued_ns] : batch)
+                    worker.execution_latency.record(completed_ns - dequeued_ns);
+
+                worker.last_completion_ns = completed_ns;
+                batch.clear();
+            }
+        }
+
+    public:
+        StreamingExecutor(AccountTable& accounts,
+                          JournalArena& journal_arena,
+                          const StreamOptions& options,
+                          const WorkloadOptions& workload,
+                          unsigned int worker_count)
+            : accounts(accounts), options(options), workload(workload), queue(options.queue_capacity),
+            generator_stalls(options.generator_count, 0) {
+            for (unsigned int worker_index = 0; worker_index < worker_count; worker_index++)
+                workers.push_back(std::make_unique<StreamWorker>(journal_arena));
+        }
+
+        StreamStats run() {
+            start_ns = now_ns();
+
+            std::deque<std::thread> worker_threads;
+            for (unsigned int worker_index = 0; worker_index < workers.size(); worker_index++)
+                worker_threads.emplace_back(&StreamingExecutor::_run_worker, this, worker_index);
+
+            std::deque<std::thread> generator_threads;
+            for (unsigned int generator_index = 0; generator_index < options.generator_count; generator_index++)
+                generator_threads.emplace_back(&StreamingExecutor::_run_generator, this, generator_index);
+
+            for (auto &thread : generator_threads)
+                thread.join();
+
+            queue.close();
+
+            for (auto &thread : worker_threads)
+                thread.join();
+
+            StreamStats stats;
+            std::int64_t end_ns = start_ns;
+            for (const auto& worker : workers) {
+                stats.queue_latency.merge(worker->queue_latency);
+                stats.execution_latency.merge(worker->execution_latency);
+                stats.lock_waits.merge(worker->lock_waits);
+                end_ns = std::max(end_ns, worker->last_completion_ns);
+            }
+
+            for (const std::size_t stalls : generator_stalls)
+                stats.full_queue_stalls += stalls;
+
+            stats.elapsed_ms = (end_ns - start_ns) / 1e6;
+
+            return stats;
+        }
+};
+
+struct CheckerStats {
+    std::size_t check_count = 0;
+    std::size_t retry_count = 0;
+    std::size_t fallback_count = 0;
+    double total_check_us = 0;
+    double max_check_us = 0;
+    std::size_t accounts_checked = 0;
+
+    void record(double check_us, std::size_t retries) {
+        check_count++;
+        retry_count += retries;
+        total_check_us += check_us;
+        max_check_us = std::max(max_check_us, check_us);
+    }
+};
+
+const char* checker_mode_name(CheckerMode mode) {
+    switch (mode) {
+        case CheckerMode::LOCK_ALL: return "lock-all";
+        case CheckerMode::SNAPSHOT: return "snapshot";
+        case CheckerMode::INCREMENTAL: return "incremental";
+    }
+
+    return "unknown";
+}
+
+CheckerMode parse_checker_mode(const std::string& name) {
+    for (const CheckerMode mode : { CheckerMode::LOCK_ALL, CheckerMode::SNAPSHOT, CheckerMode::INCREMENTAL })
+        if (name == checker_mode_name(mode))
+            return mode;
+
+    throw std::runtime_error("Unknown checker mode: " + name);
+}
+
+class ConsistencyChecker {
+    private:
+        AccountTable& accounts;
+        const JournalArena& journal_arena;
+        std::atomic<bool>& running;
+
+        const std::chrono::nanoseconds interval;
+        const bool verbose;
+        const CheckerMode mode;
+
+        CheckerStats stats;
+        std::vector<std::uint32_t> snapshot_versions;
+
+        // Incremental checkpoint: each account's balance has been verified up
+        // to verified_log_positions[uid] in its log.
+        std::vector<unsigned int> verified_balances;
+        std::vector<std::size_t> verified_log_positions;
+        unsigned int verified_total_balance = 0;
+        unsigned int expected_total_balance = 0;
+        std::size_t pass_count = 0;
+
+        // Walks the account's journal chain back from its newest record to
+        // start_position. Balances are unsigned, so the order of the deltas
+        // does not matter.
+        unsigned int _replay_log(std::uint32_t uid, std::size_t start_position, unsigned int start_balance) const {
+            unsigned int expected_balance = start_balance;
+
+            JournalRef ref = accounts.log_head(uid);
+            for (std::uint32_t position = accounts.log_length(uid); position > start_position; position--) {
+                const JournalRecord& record = journal_arena.record(ref);
+
+                if (record.payee_uid == uid && record.payee_sequence == position) {
+                    expected_balance += record.amount;
+                    ref = record.previous_payee_record;
+                } else if (record.payer_uid == uid && record.payer_sequence == position) {
+                    expected_balance -= record.amount;
+                    ref = record.previous_payer_record;
+                } else
+                    throw std::runtime_error("Logged transfer is not related to account!");
+            }
+
+            return expected_balance;
+        }
+
+        void _check_dirty_account(std::uint32_t uid) {
+            const unsigned int expected_balance = 
+                _replay_log(uid, verified_log_positions[uid], verified_balances[uid]);
+
+            if (expected_balance != accounts.balance(uid))
+                throw std::runtime_error("Account balance is different from expected balance!");
+
+            verified_total_balance += expected_balance - verified_balances[uid];
+            verified_balances[uid] = expected_balance;
+            verified_log_positions[uid] = accounts.log_length(uid);
+        }
+
+        // Double collect: read every (version, balance) pair, then re-read the
+        // versions. If none was odd and none moved, no transfer overlapped the
+        // collect and the balances form a consistent cut.
+        bool _try_snapshot_total(unsigned int& bank_total_balance) {
+            bank_total_balance = 0;
+
+            for (std::uint32_t uid = 0; uid < accounts.size(); uid++) {
+                const std::uint32_t version = accounts.version(uid);
+                if (version & 1)
+                    return false;
+
+                snapshot_versions[uid] = version;
+                bank_total_balance += accounts.balance(uid);
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+
+            for (std::uint32_t uid = 0; uid < accounts.size(); uid++)
+                if (accounts.version(uid, std::memory_order_relaxed) != snapshot_versions[uid])
+                    return false;
+
+            return true;
+        }
+
+        void _lock_all_and_check() {
+            for (std::uint32_t uid = 0; uid < accounts.size(); uid++)
+                accounts.mutex(uid).lock();
+
+            check();
+
+            for (std::uint32_t uid = 0; uid < accounts.size(); uid++)
+                accounts.mutex(uid).unlock();
+        }
+
+    public:
+        ConsistencyChecker(AccountTable& accounts,
+                           const JournalArena& journal_arena,
+                           std::atomic<bool>& running,
+                           std::chrono::nanoseconds interval = std::chrono::nanoseconds(CHECKER_SLEEP_DURATION_NS),
+                           bool verbose = true,
+                           CheckerMode mode = CHECKER_MODE)
+            : accounts(accounts), journal_arena(journal_arena), running(running), 
+            interval(interval), verbose(verbose), mode(mode) {}
+
+        CheckerMode get_mode() const {
+            return mode;
+        }
+
+        // Must run once the initial balances are set and before any transfer.
+        void reset_checkpoint() {
+            verified_balances.resize(accounts.size());
+            verified_log_positions.assign(accounts.size(), 0);
+            verified_total_balance = 0;
+
+            for (std::uint32_t uid = 0; uid < accounts.size(); uid++) {
+                verified_balances[uid] = accounts.initial_balance(uid);
+                verified_total_balance += verified_balances[uid];
+            }
+
+            expected_total_balance = verified_total_balance;
+        }
+
+        const CheckerStats& get_stats() const {
+            return stats;
+        }
+
+        unsigned int check_account(std::uint32_t uid) const {
+            const unsigned int expected_balance = _replay_log(uid, 0, accounts.initial_balance(uid));
+
+            if (expected_balance != accounts.balance(uid))
+                throw std::runtime_error("Account balance is different from expected balance!");
+
+            return expected_balance;
+        }
+
+        // Caller must guarantee that no transfer is running, either by holding
+        // every account mutex or by calling between two batches.
+        void check() const {
+            unsigned int bank_total_balance = 0;
+            unsigned int expected_total_balance = 0;
+
+            for (std::uint32_t uid = 0; uid < accounts.size(); uid++) {
+                unsigned int expected_balance = check_account(uid);
+
+                bank_total_balance += accounts.balance(uid);
+                expected_total_balance += expected_balance;
+            }
+
+            if (bank_total_balance != expected_total_balance)
+                throw std::runtime_error("Bank total balance is differented form expected balance!");
+
+            if (verbose)
+                std::cout << "Consistency check succeeded!" << std::endl;
+        }
+
+        // Verifies the bank total on a lock-free snapshot. Returns false if the
+        // snapshot kept conflicting and the stop-the-world check was used.
+        bool check_snapshot_total(std::size_t& retries) {
+            snapshot_versions.resize(accounts.size());
+
+            retries = 0;
+            unsigned int bank_total_balance = 0;
+            bool consistent = _try_snapshot_total(bank_total_balance);
+            while (!consistent && retries < MAX_SNAPSHOT_RETRIES) {
+                retries++;
+                consistent = _try_snapshot_total(bank_total_balance);
+            }
+
+            if (!consistent) {
+                stats.fallback_count++;
+                _lock_all_and_check();
+
+                return false;
+            }
+
+            if (bank_total_balance != expected_total_balance)
+                throw std::runtime_error("Bank total balance is differented form expected balance!");
+
+            return true;
+        }
+
+        void check_snapshot_total() {
+            std::size_t retries;
+            check_snapshot_total(retries);
+
+            stats.retry_count += retries;
+        }
+
+        // Verifies the bank total on a lock-free snapshot and then audits each
+        // account under its own lock only, so transfers keep running. Falls
+        // back to the stop-the-world check if the snapshot keeps conflicting.
+        void check_snapshot() {
+            const auto t_start = std::chrono::high_resolution_clock::now();
+
+            std::size_t retries;
+            if (check_snapshot_total(retries)) {
+                for (std::uint32_t uid = 0; uid < accounts.size(); uid++) {
+                    std::lock_guard<std::mutex> lock(accounts.mutex(uid));
+                    check_account(uid);
+                }
+            }
+
+            const auto t_end = std::chrono::high_resolution_clock::now();
+            const double check_us = std::chrono::duration<double, std::micro>(t_end - t_start).count();
+            stats.record(check_us, retries);
+
+            if (verbose)
+                std::cout << "Consistency check succeeded in " << check_us << "us (" 
+                << retries << " retries)!" << std::endl;
+        }
+
+        // Replays only the log entries appended since the last pass, and only
+        // for accounts marked dirty, so the cost follows recent activity. When
+        // quiescent every account is verified at the same instant and the
+        // running total of verified balances must equal the bank total.
+        void check_incremental(bool quiescent) {
+            const auto t_start = std::chrono::high_resolution_clock::now();
+
+            const std::vector<std::uint32_t> dirty_uids = accounts.dirty_accounts().take();
+            for (const std::uint32_t uid : dirty_uids) {
+                accounts.dirty_accounts().clear(uid);
+
+                if (quiescent)
+                    _check_dirty_account(uid);
+                else {
+                    std::lock_guard<std::mutex> lock(accounts.mutex(uid));
+                    _check_dirty_account(uid);
+                }
+            }
+
+            if (quiescent && verified_total_balance != expected_total_balance)
+                throw std::runtime_error("Bank total balance is differented form expected balance!");
+
+            const auto t_end = std::chrono::high_resolution_clock::now();
+            const double check_us = std::chrono::duration<double, std::micro>(t_end - t_start).count();
+            stats.record(check_us, 0);
+            stats.accounts_checked += dirty_uids.size();
+
+            if (verbose)
+                std::cout << "Incremental check of " << dirty_uids.size() << " accounts succeeded in " 
+                << check_us << "us!" << std::endl;
+        }
+
+        std::chrono::nanoseconds get_interval() const {
+            return interval;
+        }
+
+        void run() {
+            while (running) {
+                if (mode == CheckerMode::INCREMENTAL) {
+                    check_incremental(false);
+
+                    if (++pass_count % SNAPSHOT_TOTAL_INTERVAL == 0)
+                        check_snapshot_total();
+                } else if (mode == CheckerMode::SNAPSHOT)
+                    check_snapshot();
+                else {
+                    const auto t_start = std::chrono::high_resolution_clock::now();
+                    _lock_all_and_check();
+                    const auto t_end = std::chrono::high_resolution_clock::now();
+
+                    stats.record(std::chrono::duration<double, std::micro>(t_end - t_start).count(), 0);
+                }
+
+                std::this_thread::sleep_for(interval);
+            }
+        }
+};
+
+// Reusable barrier; the last thread to arrive runs on_completion while all
+// others are still blocked, so it gets a quiescent view of the bank.
+class Barrier {
+    private:
+        const unsigned int thread_count;
+        unsigned int waiting = 0;
+        std::size_t generation = 0;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+
+    public:
+        explicit Barrier(unsigned int thread_count) : thread_count(thread_count) {}
+
+        template <typename Completion>
+        void arrive_and_wait(Completion on_completion) {
+            std::unique_lock<std::mutex> lock(mutex);
+            const std::size_t arrival_generation = generation;
+
+            if (++waiting == thread_count) {
+                on_completion();
+
+                waiting = 0;
+                generation++;
+                condition.notify_all();
+
+                return;
+            }
+
+            condition.wait(lock, [this, arrival_generation]() { return generation != arrival_generation; });
+        }
+};
+
+// Splits transfers into batches in which no two transfers share an account.
+// A transfer is placed one batch after the latest batch that already touches
+// its payer or payee, so every account sees its transfers in uid order and
+// the outcome is identical to executing all transfers sequentially.
+class BatchScheduler {
+    public:
+        static std::vector<std::vector<Transfer*>> build_batches(
+                std::vector<Transfer>& transfers,
+                std::size_t account_count) {
+            std::vector<std::vector<Transfer*>> batches;
+            std::vector<std::size_t> next_free_batch(account_count, 0);
+
+            for (Transfer& transfer : transfers) {
+                const std::size_t batch_index = std::max(next_free_batch[transfer.payer_uid],
+                                                         next_free_batch[transfer.payee_uid]);
+                if (batch_index == batches.size())
+                    batches.emplace_back();
+
+                batches[batch_index].push_back(&transfer);
+                next_free_batch[transfer.payer_uid] = batch_index + 1;
+                next_free_batch[transfer.payee_uid] = batch_index + 1;
+            }
+
+            return batches;
+        }
+};
+
+class BatchExecutor {
+    private:
+        const std::vector<std::vector<Transfer*>>& batches;
+        AccountTable& accounts;
+        ConsistencyChecker& consistency_checker;
+        const unsigned int worker_count;
+        const unsigned int checker_batch_interval;
+
+        std::vector<TransferJournal> journals;
+        Barrier barrier;
+
+        void _run_worker(unsigned int worker_index) {
+            for (std::size_t batch_index = 0; batch_index < batches.size(); batch_index++) {
+                const auto& batch = batches[batch_index];
+
+                for (std::size_t transfer_index = worker_index; 
+                        transfer_index < batch.size(); transfer_index += worker_count)
+                    batch[transfer_index]->execute_unlocked(accounts, journals[worker_index]);
+
+                journals[worker_index].sync();
+
+                barrier.arrive_and_wait([this, batch_index]() {
+                    if ((batch_index + 1) % checker_batch_interval == 0 || batch_index + 1 == batches.size())
+                        consistency_checker.check_incremental(true);
+                });
+            }
+        }
+
+    public:
+        BatchExecutor(const std::vector<std::vector<Transfer*>>& batches,
+                      AccountTable& accounts,
+                      JournalArena& journal_arena,
+                      ConsistencyChecker& consistency_checker,
+                      unsigned int worker_count,
+                      unsigned int checker_batch_interval = CHECKER_BATCH_INTERVAL)
+            : batches(batches), accounts(accounts), consistency_checker(consistency_checker), 
+            worker_count(worker_count), checker_batch_interval(checker_batch_interval), journals(worker_count, TransferJournal(journal_arena)), 
+            barrier(worker_count) {}
+
+        void run() {
+            std::deque<std::thread> worker_threads;
+            for (unsigned int worker_index = 0; worker_index < worker_count; worker_index++)
+                worker_threads.emplace_back(&BatchExecutor::_run_worker, this, worker_index);
+
+            for (auto &thread : worker_threads)
+                thread.join();
+        }
+};
+
+double percentile(std::vector<double> values, double quantile) {
+    if (values.empty())
+        return 0;
+
+    std::sort(values.begin(), values.end());
+    const std::size_t rank = static_cast<std::size_t>(std::ceil(quantile * values.size()));
+
+    return values[std::max<std::size_t>(rank, 1) - 1];
+}
+
+struct BankOptions {
+    unsigned int worker_count = DEFAULT_WORKER_COUNT;
+    ExecutionMode execution_mode = EXECUTION_MODE;
+    CheckerMode checker_mode = CHECKER_MODE;
+    unsigned int checker_interval_us = CHECKER_SLEEP_DURATION_NS / 1000;
+    unsigned int checker_batch_interval = CHECKER_BATCH_INTERVAL;
+    bool verbose_checker = true;
+
+    WorkloadOptions workload;
+    WalOptions wal;
+};
+
+struct RunStats {
+    std::size_t transfer_count = 0;
+    double elapsed_ms = 0;
+    LockWaitStats lock_waits;
+    CheckerStats checker;
+
+    double throughput() const {
+        return transfer_count / (elapsed_ms / 1000.0);
+    }
+};
+
+class Bank {
+    AccountTable accounts;
+    std::vector<Transfer> transfers;
+    std::atomic<bool> run_checker;
+    JournalArena journal_arena;
+
+    const unsigned int worker_count;
+    const ExecutionMode execution_mode;
+    const unsigned int checker_batch_interval;
+    const WorkloadOptions workload;
+    ConsistencyChecker consistency_checker;
+
+    const WalOptions wal_options;
+    std::unique_ptr<WriteAheadLog> wal;
+
+    RunStats run_stats;
+
+    std::vector<std::vector<Transfer*>> batches;
+
+    void _create_accounts(unsigned int account_count,
+                          unsigned int max_amount) {
+        for (std::uint32_t uid = 0; uid < account_count; uid++)
+            accounts.open_account(uid, random_int(0, max_amount));
+    }
+
+    void _create_transfers(std::size_t transfer_count) {
+        TransferGenerator generator(workload, thread_rng()());
+
+        transfers.reserve(transfer_count);
+        for (std::uint32_t uid = 0; uid < transfer_count; uid++) {
+            const GeneratedTransfer transfer = generator.next();
+
+            transfers.emplace_back(uid, transfer.amount, transfer.payee_uid, transfer.payer_uid);
+        }
+    }
+
+    // Rebuilds balances by replaying the WAL; the recovered balances become
+    // the new initial balances. Returns false if there was nothing to replay.
+    bool _recover_accounts() {
+        const std::vector<WalRecord> records = WriteAheadLog::read_records(wal_options.path);
+        if (records.empty())
+            return false;
+
+        std::vector<unsigned int> balances(accounts.size(), 0);
+        for (const WalRecord& record : records) {
+            if (std::max(record.payer_uid, record.payee_uid) >= accounts.size())
+                throw std::runtime_error("WAL references an account outside the bank!");
+
+            if (record.type == WalRecordType::OPEN_ACCOUNT)
+                balances[record.payer_uid] = record.amount;
+            else {
+                balances[record.payer_uid] -= record.amount;
+                balances[record.payee_uid] += record.amount;
+            }
+        }
+
+        unsigned int total_balance = 0;
+        for (std::uint32_t uid = 0; uid < accounts.size(); uid++) {
+            accounts.open_account(uid, balances[uid]);
+            total_balance += balances[uid];
+        }
+
+        std::cout << "Recovered " << accounts.size() << " accounts from " << records.size() 
+            << " WAL records (total balance " << total_balance << ")" << std::endl;
+
+        return true;
+    }
+
+    void _open_wal_and_accounts() {
+        if (wal_options.path.empty()) {
+            _create_accounts(accounts.size(), MAX_ACCOUNT_AMOUNT);
+            return;
+        }
+
+        if (wal_options.recover && _recover_accounts()) {
+            wal = std::make_unique<WriteAheadLog>(wal_options);
+        } else {
+            wal = std::make_unique<WriteAheadLog>(wal_options);
+            _create_accounts(accounts.size(), MAX_ACCOUNT_AMOUNT);
+
+            for (std::uint32_t uid = 0; uid < accounts.size(); uid++)
+                wal->append({ WalRecordType::OPEN_ACCOUNT, 0, uid, uid, accounts.initial_balance(uid), 0 });
+        }
+
+        journal_arena.attach_wal(wal.get());
+    }
+
+    void _report_throughput(double elapsed_time_ms) {
+        std::cout << "Throughput: " << transfers.size() / (elapsed_time_ms / 1000.0) 
+            << " transfers/s" << std::endl;
+
+        _report_wal();
+    }
+
+    void _report_checker() const {
+        const CheckerStats& stats = consistency_checker.get_stats();
+        std::cout << "Checker: " << stats.check_count << " checks, "
+            << (stats.check_count ? stats.total_check_us / stats.check_count : 0) << "us mean, "
+            << stats.max_check_us << "us max, " << stats.retry_count << " retries, "
+            << stats.fallback_count << " fallbacks, " << stats.accounts_checked 
+            << " incremental account checks" << std::endl;
+    }
+
+    void _record_run(std::size_t transfer_count, double elapsed_ms, const LockWaitStats& lock_waits) {
+        run_stats.transfer_count = transfer_count;
+        run_stats.elapsed_ms = elapsed_ms;
+        run_stats.lock_waits = lock_waits;
+        run_stats.checker = consistency_checker.get_stats();
+
+        if (lock_waits.contended_count)
+            std::cout << "Lock wait: " << lock_waits.wait_ns / 1e6 << "ms over " 
+                << lock_waits.contended_count << " contended transfers" << std::endl;
+    }
+
+    void _report_wal() const {
+        if (!wal)
+            return;
+
+        const WalStats& stats = wal->get_stats();
+        std::cout << "WAL: " << stats.commit_count << " group commits, "
+            << (stats.commit_count ? double(stats.record_count) / stats.commit_count : 0) << " records/commit, "
+            << "commit latency p50 " << percentile(stats.commit_latencies_us, 0.50) << "us, "
+            << "p99 " << percentile(stats.commit_latencies_us, 0.99) << "us" << std::endl;
+    }
+
+    static void _report_latency(const char* name, const LatencyHistogram& histogram) {
+        std::cout << name << " latency: p50 " << histogram.value_at(0.50) / 1000.0 << "us, "
+            << "p99 " << histogram.value_at(0.99) / 1000.0 << "us, "
+            << "p99.9 " << histogram.value_at(0.999) / 1000.0 << "us, "
+            << "max " << histogram.max() / 1000.0 << "us" << std::endl;
+    }
+
+    public:
+        explicit Bank(const BankOptions& options = BankOptions()) 
+            : accounts(options.workload.account_count), worker_count(options.worker_count), 
+            execution_mode(options.execution_mode), checker_batch_interval(options.checker_batch_interval),
+            workload(options.workload), 
+            consistency_checker(accounts, journal_arena, run_checker, 
+                    std::chrono::microseconds(options.checker_interval_us), options.verbose_checker,
+                    options.checker_mode), 
+            wal_options(options.wal) {}
+
+        const RunStats& get_run_stats() const {
+            return run_stats;
+        }
+
+        void prepare_bank() {
+            _open_wal_and_accounts();
+            consistency_checker.reset_checkpoint();
+            _create_transfers(workload.transfer_count);
+
+            if (execution_mode == ExecutionMode::CONFLICT_FREE_BATCHES)
+                batches = BatchScheduler::build_batches(transfers, accounts.size());
+
+            // Every worker may leave one block partially filled.
+            journal_arena.reserve(transfers.size() + worker_count * JOURNAL_BLOCK_RECORDS);
+        }
+
+        void open_bank() {
+            if (execution_mode == ExecutionMode::CONFLICT_FREE_BATCHES)
+                _run_batches();
+            else
+                _run_locked_workers();
+        }
+
+        // Streamed transfers are generated on the fly, so only the accounts
+        // and the journal are set up front.
+        void prepare_stream(const StreamOptions& options) {
+            _open_wal_and_accounts();
+            consistency_checker.reset_checkpoint();
+
+            journal_arena.reserve(options.transfer_count + worker_count * JOURNAL_BLOCK_RECORDS);
+        }
+
+        // Streamed transfers can land in any order, so instead of a sequential
+        // replay the checker runs alongside and does a final quiescent pass.
+        void open_stream(const StreamOptions& options) {
+            StreamingExecutor executor(accounts, journal_arena, options, workload, worker_count);
+
+            run_checker = true;
+            std::thread checker_thread(&ConsistencyChecker::run, &consistency_checker);
+
+            const StreamStats stats = executor.run();
+
+            run_checker = false;
+            checker_thread.join();
+
+            if (consistency_checker.get_mode() == CheckerMode::INCREMENTAL)
+                consistency_checker.check_incremental(true);
+            else
+                consistency_checker.check();
+
+            if (wal)
+                wal->close_log();
+
+            std::cout << "Stream closed after " << stats.elapsed_ms << "ms (" << options.generator_count 
+                << " generators, " << worker_count << " workers, " << stats.full_queue_stalls 
+                << " full-queue stalls)" << std::endl;
+
+            std::cout << "Sustained throughput: " << options.transfer_count / (stats.elapsed_ms / 1000.0) 
+                << " transfers/s (target ";
+            if (options.target_rate > 0)
+                std::cout << options.target_rate << " transfers/s)" << std::endl;
+            else
+                std::cout << "unthrottled)" << std::endl;
+
+            _record_run(options.transfer_count, stats.elapsed_ms, stats.lock_waits);
+            _report_latency("Queueing", stats.queue_latency);
+            _report_latency("Execution", stats.execution_latency);
+            _report_wal();
+        }
+
+        std::vector<std::uint32_t> transfers_logged(std::uint32_t uid) const {
+            std::vector<std::uint32_t> transfer_uids;
+            transfer_uids.reserve(accounts.log_length(uid));
+
+            for (JournalRef ref = accounts.log_head(uid); ref != NO_JOURNAL_RECORD; ) {
+                const JournalRecord& record = journal_arena.record(ref);
+
+                transfer_uids.push_back(record.transfer_uid);
+                ref = record.payer_uid == uid ? record.previous_payer_record : record.previous_payee_record;
+            }
+
+            std::reverse(transfer_uids.begin(), transfer_uids.end());
+
+            return transfer_uids;
+        }
+
+        // Replays all transfers in uid order on a private copy of the initial
+        // balances and compares final balances and logs with the live accounts.
+        void verify_against_sequential_replay() const {
+            std::vector<unsigned int> balances(accounts.size());
+            std::vector<std::vector<std::uint32_t>> logs(accounts.size());
+            for (std::uint32_t uid = 0; uid < accounts.size(); uid++)
+                balances[uid] = accounts.initial_balance(uid);
+
+            for (const Transfer& transfer : transfers) {
+                const std::uint32_t uid = transfer.uid;
+
+                if (transfer.payer_uid == transfer.payee_uid 
+                        || balances[transfer.payer_uid] < transfer.amount_transferred)
+                    continue;
+
+                balances[transfer.payer_uid] -= transfer.amount_transferred;
+                logs[transfer.payer_uid].push_back(uid);
+
+                balances[transfer.payee_uid] += transfer.amount_transferred;
+                logs[transfer.payee_uid].push_back(uid);
+            }
+
+            for (std::uint32_t uid = 0; uid < accounts.size(); uid++)
+                if (accounts.balance(uid) != balances[uid] || transfers_logged(uid) != logs[uid])
+                    throw std::runtime_error("Account " + std::to_string(uid) + " differs from sequential replay!");
+
+            std::cout << "Batch execution matches sequential replay!" << std::endl;
+        }
+
+    private:
+        void _run_batches() {
+            auto t_start = std::chrono::high_resolution_clock::now();
+
+            BatchExecutor executor(batches, accounts, journal_arena, consistency_checker, 
+                    worker_count, checker_batch_interval);
+            executor.run();
+
+            if (wal)
+                wal->close_log();
+
+            auto t_end = std::chrono::high_resolution_clock::now();
+            double elapsed_time_ms = std::chrono::duration<double, std::milli>(t_end-t_start).count();
+
+            std::cout << "Bank closed after " << elapsed_time_ms << "ms (" 
+                << batches.size() << " conflict-free batches)" << std::endl;
+
+            _report_checker();
+            _record_run(transfers.size(), elapsed_time_ms, LockWaitStats());
+            _report_throughput(elapsed_time_ms);
+            verify_against_sequential_replay();
+        }
+
+        void _run_locked_workers() {
+            auto t_start = std::chrono::high_resolution_clock::now();
+
+            WorkStealingExecutor executor(transfers, accounts, journal_arena, worker_count);
+
+            run_checker = true;
+            std::thread checker_thread(&ConsistencyChecker::run, &consistency_checker);
+
+            executor.run();
+
+            if (!std::all_of(transfers.begin(), transfers.end(), [](const Transfer& transfer) { return transfer.executed; }))
+                throw std::runtime_error("Not every transfer was executed!");
+
+            std::this_thread::sleep_for(consistency_checker.get_interval());
+
+            run_checker = false;
+            checker_thread.join();
+
+            if (consistency_checker.get_mode() == CheckerMode::INCREMENTAL)
+                consistency_checker.check_incremental(true);
+
+            if (wal)
+                wal->close_log();
+
+            auto t_end = std::chrono::high_resolution_clock::now();
+            double elapsed_time_ms = std::chrono::duration<double, std::milli>(t_end-t_start).count();
+
+            std::cout << "Bank closed after " << elapsed_time_ms << "ms (" 
+                << worker_count << " workers, " << executor.steal_count() << " steals)" << std::endl;
+
+            _report_checker();
+            _record_run(transfers.size(), elapsed_time_ms, executor.lock_waits());
+            _report_throughput(elapsed_time_ms);
+        }
+};
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]" << std::endl
+        << "  --workers N              worker threads (default " << DEFAULT_WORKER_COUNT << ")" << std::endl
+        << "  --accounts N             accounts in the bank (default " << ACCOUNT_COUNT << ")" << std::endl
+        << "  --transfers N            pre-generated transfers (default " << TRANSFER_COUNT << ")" << std::endl
+        << "  --mode locked|batches    execution mode (default " 
+            << (EXECUTION_MODE == ExecutionMode::LOCKED_WORKERS ? "locked" : "batches") << ")" << std::endl
+        << "  --profile NAME           uniform, zipf, whales or self (default uniform)" << std::endl
+        << "  --zipf-exponent S        skew of the zipf profile (default " << DEFAULT_ZIPF_EXPONENT << ")" << std::endl
+        << "  --whales N               hot accounts of the whales profile (default " << DEFAULT_WHALE_COUNT << ")" << std::endl
+        << "  --checker MODE           lock-all, snapshot or incremental (default " 
+            << checker_mode_name(CHECKER_MODE) << ")" << std::endl
+        << "  --checker-interval-us N  pause between checker passes (default " 
+            << CHECKER_SLEEP_DURATION_NS / 1000 << ")" << std::endl
+        << "  --checker-batches N      batches between checks in batch mode (default " 
+            << CHECKER_BATCH_INTERVAL << ")" << std::endl
+        << "  --suite                  run every profile in both modes and compare" << std::endl
+        << "  --wal PATH               log executed transfers to a write-ahead log" << std::endl
+        << "  --recover                rebuild balances from the WAL before running" << std::endl
+        << "  --commit-interval-us N   group commit interval (default " << DEFAULT_COMMIT_INTERVAL_US << ")" << std::endl
+        << "  --commit-batch N         records that force an early commit (default " 
+            << DEFAULT_COMMIT_BATCH_RECORDS << ")" << std::endl
+        << "  --sync-commit            workers wait for their transfers to be durable" << std::endl
+        << "  --wal-sweep              run once per group-commit setting and compare" << std::endl
+        << "  --stream N               execute N transfers from an open-loop stream" << std::endl
+        << "  --rate R                 stream rate in transfers/s, 0 = unthrottled (default " 
+            << DEFAULT_STREAM_RATE << ")" << std::endl
+        << "  --generators N           stream generator threads (default " << DEFAULT_GENERATOR_COUNT << ")" << std::endl
+        << "  --queue-capacity N       stream queue slots, a power of two (default " 
+            << DEFAULT_STREAM_QUEUE_CAPACITY << ")" << std::endl;
+}
+
+// Runs every workload profile under both execution modes. Checker pauses
+// are the time spent per check: in batch mode every worker waits at the
+// barrier for it, with locked workers only the accounts being audited do.
+void run_workload_suite(BankOptions options) {
+    options.verbose_checker = false;
+    options.wal.recover = false;
+
+    std::vector<std::pair<BankOptions, RunStats>> results;
+    for (const WorkloadProfile profile : { WorkloadProfile::UNIFORM, WorkloadProfile::ZIPF, 
+            WorkloadProfile::WHALES, WorkloadProfile::SELF_TRANSFERS })
+        for (const ExecutionMode mode : { ExecutionMode::LOCKED_WORKERS, ExecutionMode::CONFLICT_FREE_BATCHES }) {
+            options.workload.profile = profile;
+            options.execution_mode = mode;
+
+            std::cout << std::endl << "=== " << profile_name(profile) << " / " 
+                << (mode == ExecutionMode::LOCKED_WORKERS ? "locked" : "batches") << " ===" << std::endl;
+
+            Bank bank(options);
+            bank.prepare_bank();
+            bank.open_bank();
+
+            results.emplace_back(options, bank.get_run_stats());
+        }
+
+    std::cout << std::endl << "profile,mode,accounts,transfers,workers,throughput_tps,"
+        << "lock_wait_ms,contended_pct,checks,checker_pause_total_ms,checker_pause_max_us" << std::endl;
+
+    for (const auto& [run_options, stats] : results)
+        std::cout << profile_name(run_options.workload.profile) << ","
+            << (run_options.execution_mode == ExecutionMode::LOCKED_WORKERS ? "locked" : "batches") << ","
+            << run_options.workload.account_count << "," << stats.transfer_count << ","
+            << run_options.worker_count << "," << stats.throughput() << ","
+            << stats.lock_waits.wait_ns / 1e6 << ","
+            << 100.0 * stats.lock_waits.contended_count / std::max<std::size_t>(stats.transfer_count, 1) << ","
+            << stats.checker.check_count << "," << stats.checker.total_check_us / 1000.0 << ","
+            << stats.checker.max_check_us << std::endl;
+}
+
+int main(int argc, char** argv) {
+    BankOptions bank_options;
+    bool wal_sweep = false;
+    bool suite = false;
+    StreamOptions stream_options;
+    bool stream = false;
+
+    WalOptions& wal_options = bank_options.wal;
+    WorkloadOptions& workload = bank_options.workload;
+
+    try {
+        for (int arg_index = 1; arg_index < argc; arg_index++) {
+            const std::string arg = argv[arg_index];
+            const bool has_value = arg_index + 1 < argc;
+
+            if (arg == "--workers" && has_value)
+                bank_options.worker_count = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--accounts" && has_value)
+                workload.account_count = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--transfers" && has_value)
+                workload.transfer_count = std::stoul(argv[++arg_index]);
+            else if (arg == "--mode" && has_value) {
+                const std::string mode = argv[++arg_index];
+                if (mode != "locked" && mode != "batches")
+                    throw std::runtime_error("Unknown execution mode: " + mode);
+
+                bank_options.execution_mode = mode == "locked" ? ExecutionMode::LOCKED_WORKERS 
+                    : ExecutionMode::CONFLICT_FREE_BATCHES;
+            } else if (arg == "--checker" && has_value)
+                bank_options.checker_mode = parse_checker_mode(argv[++arg_index]);
+            else if (arg == "--profile" && has_value)
+                workload.profile = parse_profile(argv[++arg_index]);
+            else if (arg == "--zipf-exponent" && has_value)
+                workload.zipf_exponent = std::stod(argv[++arg_index]);
+            else if (arg == "--whales" && has_value)
+                workload.whale_count = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--checker-interval-us" && has_value)
+                bank_options.checker_interval_us = std::stoul(argv[++arg_index]);
+            else if (arg == "--checker-batches" && has_value)
+                bank_options.checker_batch_interval = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--suite")
+                suite = true;
+            else if (arg == "--wal" && has_value)
+                wal_options.path = argv[++arg_index];
+            else if (arg == "--recover")
+                wal_options.recover = true;
+            else if (arg == "--commit-interval-us" && has_value)
+                wal_options.commit_interval_us = std::stoul(argv[++arg_index]);
+            else if (arg == "--commit-batch" && has_value)
+                wal_options.commit_batch_records = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--sync-commit")
+                wal_options.sync_commit = true;
+            else if (arg == "--wal-sweep")
+                wal_sweep = true;
+            else if (arg == "--stream" && has_value) {
+                stream_options.transfer_count = std::stoul(argv[++arg_index]);
+                stream = true;
+            } else if (arg == "--rate" && has_value)
+                stream_options.target_rate = std::max(0.0, std::stod(argv[++arg_index]));
+            else if (arg == "--generators" && has_value)
+                stream_options.generator_count = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--queue-capacity" && has_value) {
+                stream_options.queue_capacity = std::stoul(argv[++arg_index]);
+                if (stream_options.queue_capacity < 2 
+                        || (stream_options.queue_capacity & (stream_options.queue_capacity - 1)) != 0)
+                    throw std::runtime_error("Queue capacity must be a power of two!");
+            } else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (suite) {
+            run_workload_suite(bank_options);
+            return 0;
+        }
+
+        if (wal_sweep) {
+            if (wal_options.path.empty())
+                wal_options.path = DEFAULT_WAL_PATH;
+            wal_options.recover = false;
+
+            for (const unsigned int commit_interval_us : { 0u, 100u, 1000u, 10000u })
+                for (const std::size_t commit_batch_records : { 64ul, 4096ul }) {
+                    wal_options.commit_interval_us = commit_interval_us;
+                    wal_options.commit_batch_records = commit_batch_records;
+
+                    std::cout << std::endl << "=== GROUP COMMIT: " << commit_interval_us << "us / " 
+                        << commit_batch_records << " records ===" << std::endl;
+
+                    Bank bank(bank_options);
+                    bank.prepare_bank();
+                    bank.open_bank();
+                }
+
+            return 0;
+        }
+
+        Bank bank(bank_options);
+
+        if (stream) {
+            bank.prepare_stream(stream_options);
+            bank.open_stream(stream_options);
+            return 0;
+        }
+
+        bank.prepare_bank();
+        bank.open_bank();
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
 
-    bank.prepare_bank();
-    bank.open_bank();
+    return 0;
 }
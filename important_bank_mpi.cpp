@@ -0,0 +1,376 @@
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <iostream>
+
+#include <mpi.h>
+
+// Sharded bank: every rank owns the accounts with uid % rank_count == rank.
+//
+//   mpicxx -std=c++17 -O2 important_bank_mpi.cpp -o important_bank_mpi
+//   mpirun -np 4 ./important_bank_mpi --accounts-per-rank 100000
+
+static constexpr unsigned int MAX_ACCOUNT_AMOUNT = 10000;
+static constexpr unsigned int MAX_TRANSFERRED_AMOUNT = 1000;
+
+static constexpr std::size_t DEFAULT_ACCOUNTS_PER_RANK = 500;
+static constexpr std::size_t DEFAULT_TRANSFERS_PER_RANK = 100000;
+static constexpr std::size_t DEFAULT_CHECK_INTERVAL = 10000;
+static constexpr std::size_t DEFAULT_TRANSFER_WINDOW = 64;
+static constexpr std::size_t POLL_INTERVAL = 16;
+
+namespace shard {
+    const int CHIEF_RANK = 0;
+
+    const int CREDIT_TAG = 0;
+    const int ACK_TAG = 1;
+}
+
+// Every message carries the whole transfer, so neither shard has to keep a
+// table of transfers in flight; the message tag says which phase it is.
+struct ShardMessage {
+    std::uint32_t payer_uid;
+    std::uint32_t payee_uid;
+    std::uint32_t amount;
+};
+
+struct ShardOptions {
+    std::size_t accounts_per_rank = DEFAULT_ACCOUNTS_PER_RANK;
+    std::size_t transfers_per_rank = DEFAULT_TRANSFERS_PER_RANK;
+    std::size_t check_interval = DEFAULT_CHECK_INTERVAL;
+    // Cross-shard transfers a rank may coordinate at once.
+    std::size_t transfer_window = DEFAULT_TRANSFER_WINDOW;
+    // Share of transfers whose payee is forced onto the payer's shard; the
+    // rest pick the payee uniformly over the whole bank.
+    double local_fraction = 0;
+};
+
+struct ShardStats {
+    std::uint64_t local_count = 0;
+    std::uint64_t remote_count = 0;
+    std::uint64_t insufficient_count = 0;
+
+    std::uint64_t check_count = 0;
+    double total_check_ms = 0;
+    double max_check_ms = 0;
+};
+
+// Sends never block, so two shards flooding each other cannot deadlock. Each
+// message stays in the deque until MPI is done with its buffer.
+class ShardOutbox {
+    private:
+        std::deque<std::pair<ShardMessage, MPI_Request>> pending;
+
+    public:
+        void send(const ShardMessage& message, int destination_rank, int tag) {
+            pending.emplace_back(message, MPI_REQUEST_NULL);
+
+            auto& [buffer, request] = pending.back();
+            MPI_Isend(&buffer, sizeof(ShardMessage), MPI_BYTE, destination_rank, tag, MPI_COMM_WORLD, &request);
+        }
+
+        void progress() {
+            while (!pending.empty()) {
+                int completed;
+                MPI_Test(&pending.front().second, &completed, MPI_STATUS_IGNORE);
+
+                if (!completed)
+                    return;
+
+                pending.pop_front();
+            }
+        }
+
+        void wait_all() {
+            for (auto& [buffer, request] : pending)
+                MPI_Wait(&request, MPI_STATUS_IGNORE);
+
+            pending.clear();
+        }
+};
+
+// One shard per rank, driven by a single-threaded event loop. Transfers are
+// originated by the payer's shard. As in the single-process bank, a payee
+// never refuses a credit, so once the payer is debited a cross-shard
+// transfer only has to be delivered:
+//
+//   payer shard                       payee shard
+//   debit payer, hold reservation --CREDIT-->  credit payee
+//   release reservation           <--ACK-----
+//
+// The ACK lets the payer know nothing about the transfer is still in flight,
+// which is what makes the epoch-end consistency check exact.
+class ShardBank {
+    private:
+        const int rank;
+        const int rank_count;
+        const ShardOptions options;
+
+        std::vector<unsigned int> balances;
+        std::uint64_t reserved_amount = 0;
+        std::size_t outstanding_count = 0;
+        std::uint64_t expected_total_balance = 0;
+
+        ShardOutbox outbox;
+        ShardStats stats;
+        std::mt19937 rng;
+
+        int _owner(std::uint32_t uid) const {
+            return uid % rank_count;
+        }
+
+        std::uint32_t _local_index(std::uint32_t uid) const {
+            return uid / rank_count;
+        }
+
+        std::uint32_t _global_uid(std::uint32_t local_index) const {
+            return local_index * rank_count + rank;
+        }
+
+        std::uint64_t _local_total() const {
+            std::uint64_t total = reserved_amount;
+            for (const unsigned int balance : balances)
+                total += balance;
+
+            return total;
+        }
+
+        void _handle(int tag, int source_rank, const ShardMessage& message) {
+            if (tag == shard::CREDIT_TAG) {
+                balances[_local_index(message.payee_uid)] += message.amount;
+                outbox.send(message, source_rank, shard::ACK_TAG);
+            } else if (tag == shard::ACK_TAG) {
+                reserved_amount -= message.amount;
+                outstanding_count--;
+                stats.remote_count++;
+            } else
+                throw std::runtime_error("Unknown shard message tag " + std::to_string(tag) + "!");
+        }
+
+        void _poll() {
+            for (;;) {
+                int has_message;
+                MPI_Status status;
+                MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &has_message, &status);
+
+                if (!has_message)
+                    break;
+
+                ShardMessage message;
+                MPI_Recv(&message, sizeof(ShardMessage), MPI_BYTE, status.MPI_SOURCE, status.MPI_TAG,
+                        MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+                _handle(status.MPI_TAG, status.MPI_SOURCE, message);
+            }
+
+            outbox.progress();
+        }
+
+        void _originate_transfer() {
+            std::uniform_int_distribution<std::uint32_t> local_dist(0, balances.size() - 1);
+            std::uniform_int_distribution<std::uint32_t> global_dist(0, balances.size() * rank_count - 1);
+            std::uniform_int_distribution<unsigned int> amount_dist(0, MAX_TRANSFERRED_AMOUNT - 1);
+            std::bernoulli_distribution local_choice(options.local_fraction);
+
+            const std::uint32_t payer = local_dist(rng);
+            const std::uint32_t payee_uid = local_choice(rng) ? _global_uid(local_dist(rng)) : global_dist(rng);
+            const unsigned int amount = amount_dist(rng);
+
+            if (balances[payer] < amount) {
+                stats.insufficient_count++;
+                return;
+            }
+
+            if (_owner(payee_uid) == rank) {
+                const std::uint32_t payee = _local_index(payee_uid);
+
+                if (payee != payer) {
+                    balances[payer] -= amount;
+                    balances[payee] += amount;
+                }
+
+                stats.local_count++;
+                return;
+            }
+
+            balances[payer] -= amount;
+            reserved_amount += amount;
+            outstanding_count++;
+
+            outbox.send({ _global_uid(payer), payee_uid, amount }, _owner(payee_uid), shard::CREDIT_TAG);
+        }
+
+        // Waits until this shard coordinates nothing, then keeps serving the
+        // other shards until every rank is there too. After that no transfer
+        // message is in flight anywhere, so the balances form a consistent cut.
+        void _drain() {
+            while (outstanding_count > 0)
+                _poll();
+
+            MPI_Request barrier;
+            MPI_Ibarrier(MPI_COMM_WORLD, &barrier);
+
+            int all_drained = 0;
+            while (!all_drained) {
+                _poll();
+                MPI_Test(&barrier, &all_drained, MPI_STATUS_IGNORE);
+            }
+
+            outbox.wait_all();
+        }
+
+        void _check_consistency() {
+            const double t_start = MPI_Wtime();
+
+            _drain();
+
+            const std::uint64_t local[2] = { _local_total(), reserved_amount };
+            std::uint64_t global[2];
+            MPI_Allreduce(local, global, 2, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+
+            if (global[0] != expected_total_balance)
+                throw std::runtime_error("Bank total balance is different from expected balance!");
+            if (global[1] != 0)
+                throw std::runtime_error("Reservations left over after every shard drained!");
+
+            const double check_ms = (MPI_Wtime() - t_start) * 1000.0;
+            stats.check_count++;
+            stats.total_check_ms += check_ms;
+            stats.max_check_ms = std::max(stats.max_check_ms, check_ms);
+        }
+
+    public:
+        ShardBank(int rank, int rank_count, const ShardOptions& options)
+            : rank(rank), rank_count(rank_count), options(options),
+            balances(options.accounts_per_rank),
+            rng(std::random_device{}() + rank) {
+            std::uniform_int_distribution<unsigned int> balance_dist(0, MAX_ACCOUNT_AMOUNT - 1);
+            for (auto& balance : balances)
+                balance = balance_dist(rng);
+
+            const std::uint64_t local_total = _local_total();
+            MPI_Allreduce(&local_total, &expected_total_balance, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        }
+
+        // Runs the transfers in epochs of check_interval, each ending with a
+        // global consistency check. Returns this rank's elapsed seconds.
+        double run() {
+            MPI_Barrier(MPI_COMM_WORLD);
+            const double t_start = MPI_Wtime();
+
+            for (std::size_t transfer_index = 0; transfer_index < options.transfers_per_rank; transfer_index++) {
+                while (outstanding_count >= options.transfer_window)
+                    _poll();
+
+                _originate_transfer();
+
+                if ((transfer_index + 1) % POLL_INTERVAL == 0)
+                    _poll();
+
+                if ((transfer_index + 1) % options.check_interval == 0 && transfer_index + 1 < options.transfers_per_rank)
+                    _check_consistency();
+            }
+
+            _check_consistency();
+
+            return MPI_Wtime() - t_start;
+        }
+
+        const ShardStats& get_stats() const {
+            return stats;
+        }
+};
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: mpirun -np N " << program << " [options]" << std::endl
+        << "  --accounts-per-rank N    accounts owned by each shard (default "
+            << DEFAULT_ACCOUNTS_PER_RANK << ")" << std::endl
+        << "  --transfers-per-rank N   transfers originated by each shard (default "
+            << DEFAULT_TRANSFERS_PER_RANK << ")" << std::endl
+        << "  --check-interval N       transfers per shard between global checks (default "
+            << DEFAULT_CHECK_INTERVAL << ")" << std::endl
+        << "  --window N               cross-shard transfers in flight per shard (default "
+            << DEFAULT_TRANSFER_WINDOW << ")" << std::endl
+        << "  --local-fraction F       share of transfers kept on the payer's shard (default 0)" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+
+    int cluster_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &cluster_size);
+
+    int process_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &process_rank);
+
+    // Every rank parses the same arguments, so all of them agree on whether
+    // to run; only the chief reports a bad one.
+    ShardOptions options;
+    bool valid_options = true;
+    try {
+        for (int arg_index = 1; arg_index < argc && valid_options; arg_index++) {
+            const std::string arg = argv[arg_index];
+            const bool has_value = arg_index + 1 < argc;
+
+            if (arg == "--accounts-per-rank" && has_value)
+                options.accounts_per_rank = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--transfers-per-rank" && has_value)
+                options.transfers_per_rank = std::stoul(argv[++arg_index]);
+            else if (arg == "--check-interval" && has_value)
+                options.check_interval = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--window" && has_value)
+                options.transfer_window = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--local-fraction" && has_value)
+                options.local_fraction = std::clamp(std::stod(argv[++arg_index]), 0.0, 1.0);
+            else
+                valid_options = false;
+        }
+    } catch (const std::exception& error) {
+        if (process_rank == shard::CHIEF_RANK)
+            std::cerr << "Invalid option value: " << error.what() << std::endl;
+        valid_options = false;
+    }
+
+    if (!valid_options) {
+        if (process_rank == shard::CHIEF_RANK)
+            print_usage(argv[0]);
+
+        MPI_Finalize();
+        return 1;
+    }
+
+    ShardBank bank(process_rank, cluster_size, options);
+    const double elapsed_s = bank.run();
+    const ShardStats& stats = bank.get_stats();
+
+    const std::uint64_t local_counts[3] = { stats.local_count, stats.remote_count, stats.insufficient_count };
+    std::uint64_t global_counts[3];
+    MPI_Reduce(local_counts, global_counts, 3, MPI_UINT64_T, MPI_SUM, shard::CHIEF_RANK, MPI_COMM_WORLD);
+
+    // Shards wait on each other at every check, so the slowest one sets the pace.
+    double max_elapsed_s;
+    MPI_Reduce(&elapsed_s, &max_elapsed_s, 1, MPI_DOUBLE, MPI_MAX, shard::CHIEF_RANK, MPI_COMM_WORLD);
+
+    if (process_rank == shard::CHIEF_RANK) {
+        const std::uint64_t transfer_count = options.transfers_per_rank * cluster_size;
+        const std::uint64_t cross_shard_count = global_counts[1];
+
+        std::cout << "Sharded bank closed after " << max_elapsed_s * 1000.0 << "ms (" << cluster_size
+            << " ranks, " << options.accounts_per_rank * cluster_size << " accounts)" << std::endl;
+        std::cout << "Transfers: " << global_counts[0] << " local, " << global_counts[1] << " cross-shard, "
+            << global_counts[2] << " insufficient funds ("
+            << 100.0 * cross_shard_count / std::max<std::uint64_t>(transfer_count, 1) << "% cross-shard)" << std::endl;
+        std::cout << "Checker: " << stats.check_count << " global checks, "
+            << stats.total_check_ms / std::max<std::uint64_t>(stats.check_count, 1) << "ms mean, "
+            << stats.max_check_ms << "ms max on the chief" << std::endl;
+        std::cout << "Throughput: " << transfer_count / max_elapsed_s << " transfers/s" << std::endl;
+    }
+
+    MPI_Finalize();
+
+    return 0;
+}
@@ -0,0 +1,562 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#endif
+
+// Register tile of the GEMM microkernel: MR rows of A times NR columns of B,
+// i.e. twelve 8-lane AVX2 accumulators.
+static constexpr std::size_t GEMM_MR = 6;
+static constexpr std::size_t GEMM_NR = 16;
+// Cache blocks: a KC x NC panel of B stays in L2/L3 while MC x KC blocks of A
+// stream through L1/L2.
+static constexpr std::size_t GEMM_MC = 96;
+static constexpr std::size_t GEMM_KC = 256;
+static constexpr std::size_t GEMM_NC = 1024;
+
+// Output tiles handed to tasks by the blocked strategy and the expression
+// evaluator.
+static constexpr std::size_t GEMM_TILE_ROWS = GEMM_MC;
+static constexpr std::size_t GEMM_TILE_COLS = 256;
+
+struct Tile {
+    std::size_t row_begin;
+    std::size_t row_end;
+    std::size_t col_begin;
+    std::size_t col_end;
+};
+
+// Row-major window into a larger buffer; stride is the distance between rows.
+template <typename T>
+struct ConstMatrixView {
+    const T* data;
+    std::size_t stride;
+
+    const T* row(std::size_t row_index) const {
+        return data + row_index * stride;
+    }
+
+    ConstMatrixView block(std::size_t row_index, std::size_t col_index) const {
+        return { row(row_index) + col_index, stride };
+    }
+};
+
+template <typename T>
+struct MatrixView {
+    T* data;
+    std::size_t stride;
+
+    T* row(std::size_t row_index) const {
+        return data + row_index * stride;
+    }
+
+    MatrixView block(std::size_t row_index, std::size_t col_index) const {
+        return { row(row_index) + col_index, stride };
+    }
+
+    operator ConstMatrixView<T>() const {
+        return { data, stride };
+    }
+};
+
+// Row-major matrix in one contiguous buffer. Columns are read through a
+// transposed copy that is built on first use and shared by every reader, so
+// both operands of a dot product are unit-stride and nothing is allocated
+// per element.
+template <typename T>
+class Matrix {
+    private:
+        std::vector<T> data;
+
+        mutable std::once_flag transpose_once;
+        mutable std::unique_ptr<const Matrix> transpose_cache;
+
+    public:
+        typedef T Element;
+
+        const std::size_t width;
+        const std::size_t height;
+
+        Matrix(const std::vector<std::vector<T>>& rows)
+            : width(rows[0].size()), height(rows.size()) {
+            data.reserve(width * height);
+            for (const auto& row : rows) {
+                assert(row.size() == width);
+                data.insert(data.end(), row.begin(), row.end());
+            }
+        }
+
+        Matrix(std::size_t width, std::size_t height, T value = 0) 
+            : data(width * height, value), width(width), height(height) {}
+
+        // The transposed copy is not carried over; the new matrix builds its own.
+        Matrix(const Matrix& other) : data(other.data), width(other.width), height(other.height) {}
+
+        Matrix(Matrix&& other) : data(std::move(other.data)), width(other.width), height(other.height) {}
+
+        const T* row(std::size_t row_index) const {
+            return data.data() + row_index * width;
+        }
+
+        T* row(std::size_t row_index) {
+            assert(!transpose_cache);
+            return data.data() + row_index * width;
+        }
+
+        T get(std::size_t row_index, std::size_t col_index) const {
+            return data[row_index * width + col_index];
+        }
+
+        ConstMatrixView<T> view() const {
+            return { data.data(), width };
+        }
+
+        MatrixView<T> view() {
+            assert(!transpose_cache);
+            return { data.data(), width };
+        }
+
+        // Must not be called once transposed() was used: the cached copy
+        // would go stale.
+        void set(std::size_t row_index, std::size_t col_index, T value) {
+            assert(!transpose_cache);
+            data[row_index * width + col_index] = value;
+        }
+
+        // Thread-safe; concurrent first callers wait for a single build.
+        const Matrix& transposed() const {
+            std::call_once(transpose_once, [this]() {
+                auto transpose = std::make_unique<Matrix>(height, width);
+                for (std::size_t row_index = 0; row_index < height; row_index++)
+                    for (std::size_t col_index = 0; col_index < width; col_index++)
+                        transpose->data[col_index * height + row_index] = data[row_index * width + col_index];
+
+                transpose_cache = std::move(transpose);
+            });
+
+            return *transpose_cache;
+        }
+
+        // Column col_index as a unit-stride span of height elements.
+        const T* col(std::size_t col_index) const {
+            return transposed().row(col_index);
+        }
+};
+
+// Type products of T are summed in unless the caller asks for another.
+// Integers widen so a row of products cannot overflow; int32 sums in int64
+// and keeps int32 (wrapping, like the blocked GEMM kernels) only on request.
+template <typename T> struct ElementTraits;
+template <> struct ElementTraits<int8_t> { typedef int32_t Accumulator; };
+template <> struct ElementTraits<int16_t> { typedef int32_t Accumulator; };
+template <> struct ElementTraits<int32_t> { typedef int64_t Accumulator; };
+template <> struct ElementTraits<int64_t> { typedef int64_t Accumulator; };
+template <> struct ElementTraits<float> { typedef float Accumulator; };
+template <> struct ElementTraits<double> { typedef double Accumulator; };
+
+template <typename T>
+using DefaultAccumulator = typename ElementTraits<T>::Accumulator;
+
+// int32 arithmetic that wraps modulo 2^32 like the AVX2 lanes do; plain
+// signed overflow would be undefined.
+inline int32_t wrapping_add(int32_t a, int32_t b) {
+    return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+}
+
+inline int32_t wrapping_sub(int32_t a, int32_t b) {
+    return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b));
+}
+
+inline int32_t wrapping_mul(int32_t a, int32_t b) {
+    return static_cast<int32_t>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b));
+}
+
+// Integer sums run in the unsigned type so overflow wraps instead of being
+// undefined; floating point sums as is.
+template <typename Acc, bool = std::is_integral_v<Acc>>
+struct WrappingSum { typedef Acc Type; };
+
+template <typename Acc>
+struct WrappingSum<Acc, true> { typedef std::make_unsigned_t<Acc> Type; };
+
+// Dot product kernels, picked at compile time by (element, accumulator).
+// The generic one widens both operands before multiplying and wraps integer
+// sums in the unsigned type of the accumulator; the
+// specializations below replace it with one AVX2 loop per pair when the CPU
+// has it.
+template <typename T, typename Acc>
+struct DotKernel {
+    static Acc scalar(const T* a, const T* b, std::size_t length) {
+        typedef typename WrappingSum<Acc>::Type Sum;
+
+        Sum result = 0;
+        for (std::size_t index = 0; index < length; index++)
+            result += static_cast<Sum>(static_cast<Acc>(a[index])) * static_cast<Sum>(static_cast<Acc>(b[index]));
+
+        return static_cast<Acc>(result);
+    }
+
+    static Acc run(const T* a, const T* b, std::size_t length) {
+        return scalar(a, b, length);
+    }
+};
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("avx2")))
+inline int32_t horizontal_sum_epi32(__m256i lanes) {
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2")))
+inline int64_t horizontal_sum_epi64(__m256i lanes) {
+    const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256(lanes, 1));
+
+    return _mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1);
+}
+
+// int8 -> int16 by sign extension, then madd multiplies pairs and adds them
+// into int32 lanes: 16 products per step, no intermediate overflow.
+__attribute__((target("avx2")))
+inline int32_t dot_int8_avx2(const int8_t* a, const int8_t* b, std::size_t length) {
+    __m256i sum = _mm256_setzero_si256();
+
+    std::size_t index = 0;
+    for (; index + 16 <= length; index += 16) {
+        const __m256i a_lanes = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + index)));
+        const __m256i b_lanes = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + index)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a_lanes, b_lanes));
+    }
+
+    return wrapping_add(horizontal_sum_epi32(sum), DotKernel<int8_t, int32_t>::scalar(a + index, b + index, length - index));
+}
+
+__attribute__((target("avx2")))
+inline int32_t dot_int16_avx2(const int16_t* a, const int16_t* b, std::size_t length) {
+    __m256i sum = _mm256_setzero_si256();
+
+    std::size_t index = 0;
+    for (; index + 16 <= length; index += 16) {
+        const __m256i a_lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + index));
+        const __m256i b_lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + index));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a_lanes, b_lanes));
+    }
+
+    return wrapping_add(horizontal_sum_epi32(sum), DotKernel<int16_t, int32_t>::scalar(a + index, b + index, length - index));
+}
+
+__attribute__((target("avx2")))
+inline int32_t dot_int32_avx2(const int32_t* a, const int32_t* b, std::size_t length) {
+    __m256i sum = _mm256_setzero_si256();
+
+    std::size_t index = 0;
+    for (; index + 8 <= length; index += 8) {
+        const __m256i a_lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + index));
+        const __m256i b_lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + index));
+        sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(a_lanes, b_lanes));
+    }
+
+    return wrapping_add(horizontal_sum_epi32(sum), DotKernel<int32_t, int32_t>::scalar(a + index, b + index, length - index));
+}
+
+// int32 -> int64 by sign extension; mul_epi32 multiplies the low halves of
+// the 64-bit lanes into full 64-bit products.
+__attribute__((target("avx2")))
+inline int64_t dot_int32_wide_avx2(const int32_t* a, const int32_t* b, std::size_t length) {
+    __m256i sum = _mm256_setzero_si256();
+
+    std::size_t index = 0;
+    for (; index + 4 <= length; index += 4) {
+        const __m256i a_lanes = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + index)));
+        const __m256i b_lanes = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + index)));
+        sum = _mm256_add_epi64(sum, _mm256_mul_epi32(a_lanes, b_lanes));
+    }
+
+    return horizontal_sum_epi64(sum) + DotKernel<int32_t, int64_t>::scalar(a + index, b + index, length - index);
+}
+
+__attribute__((target("avx2,fma")))
+inline float dot_float_fma(const float* a, const float* b, std::size_t length) {
+    __m256 sum = _mm256_setzero_ps();
+
+    std::size_t index = 0;
+    for (; index + 8 <= length; index += 8)
+        sum = _mm256_fmadd_ps(_mm256_loadu_ps(a + index), _mm256_loadu_ps(b + index), sum);
+
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, sum);
+
+    float result = DotKernel<float, float>::scalar(a + index, b + index, length - index);
+    for (const float lane : lanes)
+        result += lane;
+
+    return result;
+}
+
+__attribute__((target("avx2,fma")))
+inline double dot_double_fma(const double* a, const double* b, std::size_t length) {
+    __m256d sum = _mm256_setzero_pd();
+
+    std::size_t index = 0;
+    for (; index + 4 <= length; index += 4)
+        sum = _mm256_fmadd_pd(_mm256_loadu_pd(a + index), _mm256_loadu_pd(b + index), sum);
+
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, sum);
+
+    double result = DotKernel<double, double>::scalar(a + index, b + index, length - index);
+    for (const double lane : lanes)
+        result += lane;
+
+    return result;
+}
+
+inline bool cpu_has_avx2_fma() {
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+}
+
+// One specialization per (element, accumulator) pair with a SIMD loop.
+#define MATRIX_DOT_KERNEL(ElementType, AccumulatorType, simd_kernel)                               \
+    template <>                                                                                    \
+    inline AccumulatorType DotKernel<ElementType, AccumulatorType>::run(                           \
+            const ElementType* a, const ElementType* b, std::size_t length) {                      \
+        return cpu_has_avx2_fma() ? simd_kernel(a, b, length) : scalar(a, b, length);               \
+    }
+
+MATRIX_DOT_KERNEL(int8_t, int32_t, dot_int8_avx2)
+MATRIX_DOT_KERNEL(int16_t, int32_t, dot_int16_avx2)
+MATRIX_DOT_KERNEL(int32_t, int32_t, dot_int32_avx2)
+MATRIX_DOT_KERNEL(int32_t, int64_t, dot_int32_wide_avx2)
+MATRIX_DOT_KERNEL(float, float, dot_float_fma)
+MATRIX_DOT_KERNEL(double, double, dot_double_fma)
+
+#undef MATRIX_DOT_KERNEL
+#endif
+
+template <typename T, typename Acc = DefaultAccumulator<T>>
+Acc dot_product(const T* a, const T* b, std::size_t length) {
+    return DotKernel<T, Acc>::run(a, b, length);
+}
+
+template <typename T, typename Acc = DefaultAccumulator<T>>
+Acc compute_element(std::size_t row_index, std::size_t col_index, const Matrix<T>& A, const Matrix<T>& B) {
+    assert(A.width == B.height);
+
+    return dot_product<T, Acc>(A.row(row_index), B.col(col_index), A.width);
+}
+
+// c[MR x NR] (row stride ldc) += a_sliver * b_sliver over depth k steps,
+// wrapping on overflow.
+typedef void (*GemmMicrokernel)(std::size_t depth, const int32_t* a_sliver, const int32_t* b_sliver, 
+                                int32_t* c, std::size_t ldc);
+
+inline void gemm_microkernel_scalar(std::size_t depth, const int32_t* a_sliver, const int32_t* b_sliver, 
+                             int32_t* c, std::size_t ldc) {
+    uint32_t accumulators[GEMM_MR][GEMM_NR] = {};
+
+    for (std::size_t k = 0; k < depth; k++, a_sliver += GEMM_MR, b_sliver += GEMM_NR)
+        for (std::size_t i = 0; i < GEMM_MR; i++)
+            for (std::size_t j = 0; j < GEMM_NR; j++)
+                accumulators[i][j] += static_cast<uint32_t>(a_sliver[i]) * static_cast<uint32_t>(b_sliver[j]);
+
+    for (std::size_t i = 0; i < GEMM_MR; i++)
+        for (std::size_t j = 0; j < GEMM_NR; j++)
+            c[i * ldc + j] = wrapping_add(c[i * ldc + j], static_cast<int32_t>(accumulators[i][j]));
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+// Each step broadcasts one element of every A row and multiplies it with two
+// vectors of the B row, so the 6x16 tile stays in registers for all of depth.
+__attribute__((target("avx2")))
+inline void gemm_microkernel_avx2(std::size_t depth, const int32_t* a_sliver, const int32_t* b_sliver, 
+                           int32_t* c, std::size_t ldc) {
+    __m256i c00 = _mm256_setzero_si256(), c01 = _mm256_setzero_si256();
+    __m256i c10 = _mm256_setzero_si256(), c11 = _mm256_setzero_si256();
+    __m256i c20 = _mm256_setzero_si256(), c21 = _mm256_setzero_si256();
+    __m256i c30 = _mm256_setzero_si256(), c31 = _mm256_setzero_si256();
+    __m256i c40 = _mm256_setzero_si256(), c41 = _mm256_setzero_si256();
+    __m256i c50 = _mm256_setzero_si256(), c51 = _mm256_setzero_si256();
+
+    for (std::size_t k = 0; k < depth; k++, a_sliver += GEMM_MR, b_sliver += GEMM_NR) {
+        const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b_sliver));
+        const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b_sliver + 8));
+
+        __m256i a = _mm256_set1_epi32(a_sliver[0]);
+        c00 = _mm256_add_epi32(c00, _mm256_mullo_epi32(a, b0));
+        c01 = _mm256_add_epi32(c01, _mm256_mullo_epi32(a, b1));
+
+        a = _mm256_set1_epi32(a_sliver[1]);
+        c10 = _mm256_add_epi32(c10, _mm256_mullo_epi32(a, b0));
+        c11 = _mm256_add_epi32(c11, _mm256_mullo_epi32(a, b1));
+
+        a = _mm256_set1_epi32(a_sliver[2]);
+        c20 = _mm256_add_epi32(c20, _mm256_mullo_epi32(a, b0));
+        c21 = _mm256_add_epi32(c21, _mm256_mullo_epi32(a, b1));
+
+        a = _mm256_set1_epi32(a_sliver[3]);
+        c30 = _mm256_add_epi32(c30, _mm256_mullo_epi32(a, b0));
+        c31 = _mm256_add_epi32(c31, _mm256_mullo_epi32(a, b1));
+
+        a = _mm256_set1_epi32(a_sliver[4]);
+        c40 = _mm256_add_epi32(c40, _mm256_mullo_epi32(a, b0));
+        c41 = _mm256_add_epi32(c41, _mm256_mullo_epi32(a, b1));
+
+        a = _mm256_set1_epi32(a_sliver[5]);
+        c50 = _mm256_add_epi32(c50, _mm256_mullo_epi32(a, b0));
+        c51 = _mm256_add_epi32(c51, _mm256_mullo_epi32(a, b1));
+    }
+
+    const __m256i rows[GEMM_MR][2] = { { c00, c01 }, { c10, c11 }, { c20, c21 }, 
+                                       { c30, c31 }, { c40, c41 }, { c50, c51 } };
+    for (std::size_t i = 0; i < GEMM_MR; i++)
+        for (std::size_t half = 0; half < 2; half++) {
+            __m256i* target = reinterpret_cast<__m256i*>(c + i * ldc + half * 8);
+            _mm256_storeu_si256(target, _mm256_add_epi32(_mm256_loadu_si256(target), rows[i][half]));
+        }
+}
+#endif
+
+inline GemmMicrokernel select_gemm_microkernel() {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("avx2"))
+        return gemm_microkernel_avx2;
+#endif
+
+    return gemm_microkernel_scalar;
+}
+
+// c[0, length) += a * b[0, length); the inner loop of sparse-times-dense.
+typedef void (*AxpyKernel)(int32_t a, const int32_t* b, int32_t* c, std::size_t length);
+
+inline void axpy_scalar(int32_t a, const int32_t* b, int32_t* c, std::size_t length) {
+    for (std::size_t index = 0; index < length; index++)
+        c[index] = wrapping_add(c[index], wrapping_mul(a, b[index]));
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((target("avx2")))
+inline void axpy_avx2(int32_t a, const int32_t* b, int32_t* c, std::size_t length) {
+    const __m256i scale = _mm256_set1_epi32(a);
+
+    std::size_t index = 0;
+    for (; index + 8 <= length; index += 8) {
+        const __m256i b_lanes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + index));
+        __m256i* target = reinterpret_cast<__m256i*>(c + index);
+        _mm256_storeu_si256(target, _mm256_add_epi32(_mm256_loadu_si256(target), _mm256_mullo_epi32(scale, b_lanes)));
+    }
+
+    axpy_scalar(a, b + index, c + index, length - index);
+}
+#endif
+
+inline AxpyKernel select_axpy_kernel() {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    if (__builtin_cpu_supports("avx2"))
+        return axpy_avx2;
+#endif
+
+    return axpy_scalar;
+}
+
+inline std::size_t round_up(std::size_t value, std::size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+// Rows [0, rows) and depth [k_begin, k_begin + depth) of A as MR-tall
+// slivers, each stored k-major; missing rows are zero.
+inline void pack_a_block(ConstMatrixView<int32_t> A, std::size_t rows, std::size_t k_begin, std::size_t depth, int32_t* packed) {
+    for (std::size_t sliver = 0; sliver < rows; sliver += GEMM_MR)
+        for (std::size_t k = 0; k < depth; k++)
+            for (std::size_t i = 0; i < GEMM_MR; i++)
+                *packed++ = sliver + i < rows ? A.row(sliver + i)[k_begin + k] : 0;
+}
+
+// Depth [k_begin, k_begin + depth) and columns [col_begin, col_begin + cols)
+// of B as NR-wide slivers, each stored k-major; missing columns are zero.
+inline void pack_b_panel(ConstMatrixView<int32_t> B, std::size_t k_begin, std::size_t depth, 
+                  std::size_t col_begin, std::size_t cols, int32_t* packed) {
+    for (std::size_t sliver = 0; sliver < cols; sliver += GEMM_NR)
+        for (std::size_t k = 0; k < depth; k++) {
+            const int32_t* b_row = B.row(k_begin + k) + col_begin + sliver;
+            const std::size_t valid = std::min(GEMM_NR, cols - sliver);
+
+            std::copy(b_row, b_row + valid, packed);
+            std::fill(packed + valid, packed + GEMM_NR, 0);
+            packed += GEMM_NR;
+        }
+}
+
+// Columns [col_begin, col_begin + cols) of B packed as pack_b_panel does,
+// read from B's transpose: column c of B is row c of BT.
+inline void pack_b_panel_transposed(ConstMatrixView<int32_t> BT, std::size_t k_begin, std::size_t depth,
+                  std::size_t col_begin, std::size_t cols, int32_t* packed) {
+    for (std::size_t sliver = 0; sliver < cols; sliver += GEMM_NR)
+        for (std::size_t k = 0; k < depth; k++)
+            for (std::size_t j = 0; j < GEMM_NR; j++)
+                *packed++ = sliver + j < cols ? BT.row(col_begin + sliver + j)[k_begin + k] : 0;
+}
+
+// C (rows x cols) += A (rows, depth [k_begin, k_begin + depth)) * a B panel
+// already packed by pack_b_panel, so a caller can pack B once and reuse it.
+inline void gemm_packed_panel(std::size_t rows, std::size_t cols, std::size_t k_begin, std::size_t depth,
+                  ConstMatrixView<int32_t> A, const int32_t* packed_b, MatrixView<int32_t> C) {
+    static const GemmMicrokernel microkernel = select_gemm_microkernel();
+
+    thread_local std::vector<int32_t> packed_a(round_up(GEMM_MC, GEMM_MR) * GEMM_KC);
+
+    for (std::size_t row_block = 0; row_block < rows; row_block += GEMM_MC) {
+        const std::size_t block_rows = std::min(GEMM_MC, rows - row_block);
+        pack_a_block(A.block(row_block, 0), block_rows, k_begin, depth, packed_a.data());
+
+        for (std::size_t j = 0; j < cols; j += GEMM_NR)
+            for (std::size_t i = 0; i < block_rows; i += GEMM_MR) {
+                const int32_t* a_sliver = packed_a.data() + i * depth;
+                const int32_t* b_sliver = packed_b + j * depth;
+                int32_t* c = C.row(row_block + i) + j;
+
+                if (i + GEMM_MR <= block_rows && j + GEMM_NR <= cols) {
+                    microkernel(depth, a_sliver, b_sliver, c, C.stride);
+                    continue;
+                }
+
+                // Edge tiles go through a scratch tile so the kernel never writes
+                // outside C.
+                int32_t edge[GEMM_MR * GEMM_NR] = {};
+                microkernel(depth, a_sliver, b_sliver, edge, GEMM_NR);
+
+                for (std::size_t row = 0; row < std::min(GEMM_MR, block_rows - i); row++)
+                    for (std::size_t col = 0; col < std::min(GEMM_NR, cols - j); col++)
+                        c[row * C.stride + col] = wrapping_add(c[row * C.stride + col], edge[row * GEMM_NR + col]);
+            }
+    }
+}
+
+// C (rows x cols) += A (rows x depth) * B (depth x cols), wrapping on
+// overflow. Packing buffers are per thread and reused, so calls are cheap
+// enough for small recursive leaves.
+inline void gemm_blocked(std::size_t rows, std::size_t cols, std::size_t depth, 
+                  ConstMatrixView<int32_t> A, ConstMatrixView<int32_t> B, MatrixView<int32_t> C) {
+    thread_local std::vector<int32_t> packed_b(GEMM_KC * round_up(GEMM_NC, GEMM_NR));
+
+    for (std::size_t col_block = 0; col_block < cols; col_block += GEMM_NC) {
+        const std::size_t block_cols = std::min(GEMM_NC, cols - col_block);
+
+        for (std::size_t k_block = 0; k_block < depth; k_block += GEMM_KC) {
+            const std::size_t block_depth = std::min(GEMM_KC, depth - k_block);
+            pack_b_panel(B, k_block, block_depth, col_block, block_cols, packed_b.data());
+            gemm_packed_panel(rows, block_cols, k_block, block_depth, A, packed_b.data(), C.block(0, col_block));
+        }
+    }
+}
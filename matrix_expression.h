@@ -0,0 +1,554 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "matrix.h"
+
+// Lazy matrix expressions. A + B, A - B, s * A, A * B and transpose(A) over
+// Matrix<T> build small expression objects that hold references to their
+// operands; nothing is computed until the expression is assigned to a
+// Matrix<T> (or passed to evaluate()). A vector is a one-column matrix, so
+// matrix-vector products are products too.
+//
+// Evaluation walks the result in GEMM_TILE_ROWS x GEMM_TILE_COLS tiles and
+// adds every term of the top-level sum into a tile while it is in cache, so
+// A * B + C is one pass with no A * B temporary: the product accumulates
+// straight into the tile, the other terms follow. A chain of products is
+// reordered by cost before it runs, so (A * B) * v is computed as
+// A * (B * v). Arithmetic is in T, as in the blocked kernel.
+
+// Runs compute_tile(0), ..., compute_tile(count - 1), possibly concurrently.
+typedef std::function<void(std::size_t count, const std::function<void(std::size_t)>& compute_tile)> TileExecutor;
+
+// Sequential until a program installs its own; matrix_multiplication.cpp
+// puts the tiles on its scheduler.
+inline TileExecutor& expression_tile_executor() {
+    static TileExecutor executor = [](std::size_t count, const std::function<void(std::size_t)>& compute_tile) {
+        for (std::size_t tile_index = 0; tile_index < count; tile_index++)
+            compute_tile(tile_index);
+    };
+
+    return executor;
+}
+
+template <typename E>
+Matrix<typename E::Element> evaluate(const E& expression);
+
+// Base of every expression node; converting to a Matrix evaluates.
+template <typename Derived, typename T>
+struct MatrixExpression {
+    typedef T Element;
+
+    operator Matrix<T>() const {
+        return evaluate(static_cast<const Derived&>(*this));
+    }
+};
+
+// A matrix operand, read as is or transposed. A transposed operand is read
+// strided, tile by tile, from the matrix itself; nothing is copied or cached
+// on the matrix, so it stays writable after the expression is evaluated.
+template <typename T>
+class MatrixRef : public MatrixExpression<MatrixRef<T>, T> {
+    private:
+        const Matrix<T>* matrix;
+        bool transposed;
+
+    public:
+        explicit MatrixRef(const Matrix<T>& matrix, bool transposed = false) : matrix(&matrix), transposed(transposed) {}
+
+        std::size_t rows() const {
+            return transposed ? matrix->width : matrix->height;
+        }
+
+        std::size_t cols() const {
+            return transposed ? matrix->height : matrix->width;
+        }
+
+        const Matrix<T>& source() const {
+            return *matrix;
+        }
+
+        bool is_transposed() const {
+            return transposed;
+        }
+};
+
+template <typename E>
+class ScaleExpr : public MatrixExpression<ScaleExpr<E>, typename E::Element> {
+    public:
+        const typename E::Element scale;
+        const E inner;
+
+        ScaleExpr(typename E::Element scale, const E& inner) : scale(scale), inner(inner) {}
+
+        std::size_t rows() const {
+            return inner.rows();
+        }
+
+        std::size_t cols() const {
+            return inner.cols();
+        }
+};
+
+template <typename L, typename R>
+class SumExpr : public MatrixExpression<SumExpr<L, R>, typename L::Element> {
+    static_assert(std::is_same_v<typename L::Element, typename R::Element>, "Operands of a sum must share their element type");
+
+    public:
+        const L left;
+        const R right;
+
+        SumExpr(const L& left, const R& right) : left(left), right(right) {
+            assert(left.rows() == right.rows() && left.cols() == right.cols());
+        }
+
+        std::size_t rows() const {
+            return left.rows();
+        }
+
+        std::size_t cols() const {
+            return left.cols();
+        }
+};
+
+template <typename L, typename R>
+class ProductExpr : public MatrixExpression<ProductExpr<L, R>, typename L::Element> {
+    static_assert(std::is_same_v<typename L::Element, typename R::Element>, "Operands of a product must share their element type");
+
+    public:
+        const L left;
+        const R right;
+
+        ProductExpr(const L& left, const R& right) : left(left), right(right) {
+            assert(left.cols() == right.rows());
+        }
+
+        std::size_t rows() const {
+            return left.rows();
+        }
+
+        std::size_t cols() const {
+            return right.cols();
+        }
+};
+
+template <typename X, typename = void>
+struct IsMatrixExpression : std::false_type {};
+
+template <typename X>
+struct IsMatrixExpression<X, std::void_t<typename X::Element>>
+    : std::is_base_of<MatrixExpression<X, typename X::Element>, X> {};
+
+template <typename X>
+struct IsMatrix : std::false_type {};
+
+template <typename T>
+struct IsMatrix<Matrix<T>> : std::true_type {};
+
+template <typename X>
+struct IsMatrixOperand : std::bool_constant<IsMatrix<X>::value || IsMatrixExpression<X>::value> {};
+
+template <typename T>
+MatrixRef<T> as_expression(const Matrix<T>& matrix) {
+    return MatrixRef<T>(matrix);
+}
+
+template <typename E, typename = std::enable_if_t<IsMatrixExpression<E>::value>>
+const E& as_expression(const E& expression) {
+    return expression;
+}
+
+template <typename X>
+using ExpressionOf = std::decay_t<decltype(as_expression(std::declval<const X&>()))>;
+
+template <typename L, typename R>
+using EnableIfOperands = std::enable_if_t<IsMatrixOperand<L>::value && IsMatrixOperand<R>::value>;
+
+template <typename L, typename R, typename = EnableIfOperands<L, R>>
+SumExpr<ExpressionOf<L>, ExpressionOf<R>> operator+(const L& left, const R& right) {
+    return { as_expression(left), as_expression(right) };
+}
+
+template <typename L, typename R, typename = EnableIfOperands<L, R>>
+SumExpr<ExpressionOf<L>, ScaleExpr<ExpressionOf<R>>> operator-(const L& left, const R& right) {
+    return { as_expression(left), { -1, as_expression(right) } };
+}
+
+template <typename L, typename R, typename = EnableIfOperands<L, R>>
+ProductExpr<ExpressionOf<L>, ExpressionOf<R>> operator*(const L& left, const R& right) {
+    return { as_expression(left), as_expression(right) };
+}
+
+template <typename X, typename = std::enable_if_t<IsMatrixOperand<X>::value>>
+ScaleExpr<ExpressionOf<X>> operator*(typename ExpressionOf<X>::Element scale, const X& operand) {
+    return { scale, as_expression(operand) };
+}
+
+// Transposes are pushed down to the operands: (A B)^T = B^T A^T, sums and
+// scales distribute, and a double transpose cancels.
+template <typename T>
+MatrixRef<T> transpose(const Matrix<T>& matrix) {
+    return MatrixRef<T>(matrix, true);
+}
+
+template <typename T>
+MatrixRef<T> transpose(const MatrixRef<T>& operand) {
+    return MatrixRef<T>(operand.source(), !operand.is_transposed());
+}
+
+template <typename E>
+auto transpose(const ScaleExpr<E>& expression) {
+    return ScaleExpr<decltype(transpose(expression.inner))>(expression.scale, transpose(expression.inner));
+}
+
+template <typename L, typename R>
+auto transpose(const SumExpr<L, R>& expression) {
+    return SumExpr<decltype(transpose(expression.left)), decltype(transpose(expression.right))>(
+            transpose(expression.left), transpose(expression.right));
+}
+
+template <typename L, typename R>
+auto transpose(const ProductExpr<L, R>& expression) {
+    return ProductExpr<decltype(transpose(expression.right)), decltype(transpose(expression.left))>(
+            transpose(expression.right), transpose(expression.left));
+}
+
+// Cheapest parenthesization of a chain of dims[0] x dims[1], dims[1] x
+// dims[2], ... matrices, by the classic O(n^3) dynamic program over
+// multiply-add counts. split[first][last] is the factor the sub-chain
+// first..last is cut after.
+inline std::vector<std::vector<std::size_t>> plan_matrix_chain(const std::vector<std::size_t>& dims) {
+    const std::size_t count = dims.size() - 1;
+    std::vector<std::vector<double>> cost(count, std::vector<double>(count, 0));
+    std::vector<std::vector<std::size_t>> split(count, std::vector<std::size_t>(count, 0));
+
+    for (std::size_t length = 2; length <= count; length++)
+        for (std::size_t first = 0; first + length <= count; first++) {
+            const std::size_t last = first + length - 1;
+            cost[first][last] = std::numeric_limits<double>::infinity();
+
+            for (std::size_t cut = first; cut < last; cut++) {
+                const double candidate = cost[first][cut] + cost[cut + 1][last]
+                    + static_cast<double>(dims[first]) * dims[cut + 1] * dims[last + 1];
+
+                if (candidate < cost[first][last]) {
+                    cost[first][last] = candidate;
+                    split[first][last] = cut;
+                }
+            }
+        }
+
+    return split;
+}
+
+// Adds coefficient * value(expression) over tile into out, which views the
+// tile's top-left element. Built once per evaluation, before any tile runs;
+// accumulate() is called concurrently for disjoint tiles.
+template <typename E>
+class Evaluator;
+
+template <typename T>
+class Evaluator<MatrixRef<T>> {
+    const MatrixRef<T> operand;
+
+    public:
+        explicit Evaluator(const MatrixRef<T>& operand) : operand(operand) {}
+
+        void accumulate(T coefficient, const Tile& tile, MatrixView<T> out) const {
+            const Matrix<T>& source = operand.source();
+
+            if (!operand.is_transposed()) {
+                for (std::size_t row_index = tile.row_begin; row_index < tile.row_end; row_index++) {
+                    const T* values = source.row(row_index) + tile.col_begin;
+                    T* target = out.row(row_index - tile.row_begin);
+
+                    for (std::size_t col = 0; col < tile.col_end - tile.col_begin; col++)
+                        target[col] += coefficient * values[col];
+                }
+                return;
+            }
+
+            // Column col of the tile is a stretch of source row col_begin + col.
+            for (std::size_t col = 0; col < tile.col_end - tile.col_begin; col++) {
+                const T* values = source.row(tile.col_begin + col) + tile.row_begin;
+
+                for (std::size_t row = 0; row < tile.row_end - tile.row_begin; row++)
+                    out.row(row)[col] += coefficient * values[row];
+            }
+        }
+};
+
+template <typename E>
+class Evaluator<ScaleExpr<E>> {
+    typedef typename E::Element T;
+
+    const T scale;
+    const Evaluator<E> inner;
+
+    public:
+        explicit Evaluator(const ScaleExpr<E>& expression) : scale(expression.scale), inner(expression.inner) {}
+
+        void accumulate(T coefficient, const Tile& tile, MatrixView<T> out) const {
+            inner.accumulate(coefficient * scale, tile, out);
+        }
+};
+
+template <typename L, typename R>
+class Evaluator<SumExpr<L, R>> {
+    typedef typename L::Element T;
+
+    const Evaluator<L> left;
+    const Evaluator<R> right;
+
+    public:
+        explicit Evaluator(const SumExpr<L, R>& expression) : left(expression.left), right(expression.right) {}
+
+        void accumulate(T coefficient, const Tile& tile, MatrixView<T> out) const {
+            left.accumulate(coefficient, tile, out);
+            right.accumulate(coefficient, tile, out);
+        }
+};
+
+// The factors of a product chain, with the scales pulled out of it and the
+// cheapest order planned. Matrix operands, transposed or not, are used in
+// place; sums are evaluated into temporaries.
+template <typename T>
+struct ProductChain {
+    std::vector<MatrixRef<T>> factors;
+    std::deque<Matrix<T>> temporaries;
+    std::vector<std::vector<std::size_t>> split;
+    T scale = 1;
+
+    template <typename L, typename R>
+    explicit ProductChain(const ProductExpr<L, R>& expression) {
+        collect(expression);
+
+        std::vector<std::size_t> dims = { factors.front().rows() };
+        for (const MatrixRef<T>& factor : factors)
+            dims.push_back(factor.cols());
+
+        split = plan_matrix_chain(dims);
+    }
+
+    ProductChain(const ProductChain&) = delete;
+
+    void collect(const MatrixRef<T>& operand) {
+        factors.push_back(operand);
+    }
+
+    template <typename E>
+    void collect(const ScaleExpr<E>& expression) {
+        scale *= expression.scale;
+        collect(expression.inner);
+    }
+
+    template <typename L, typename R>
+    void collect(const SumExpr<L, R>& expression) {
+        temporaries.push_back(evaluate(expression));
+        factors.push_back(MatrixRef<T>(temporaries.back()));
+    }
+
+    template <typename L, typename R>
+    void collect(const ProductExpr<L, R>& expression) {
+        collect(expression.left);
+        collect(expression.right);
+    }
+
+    // Product of factors first..last in the planned order.
+    MatrixRef<T> materialize(std::size_t first, std::size_t last) {
+        if (first == last)
+            return factors[first];
+
+        const std::size_t cut = split[first][last];
+        const MatrixRef<T> left = materialize(first, cut);
+        const MatrixRef<T> right = materialize(cut + 1, last);
+
+        temporaries.push_back(evaluate(ProductExpr<MatrixRef<T>, MatrixRef<T>>(left, right)));
+        return MatrixRef<T>(temporaries.back());
+    }
+
+    // The two sides of the chain's last multiplication.
+    MatrixRef<T> left_side() {
+        return materialize(0, split[0][factors.size() - 1]);
+    }
+
+    MatrixRef<T> right_side() {
+        return materialize(split[0][factors.size() - 1] + 1, factors.size() - 1);
+    }
+};
+
+// Everything in the chain but its last multiplication is computed up front;
+// that one runs tile by tile into the result. int32 products at least
+// GEMM_NR wide go through the blocked kernel: the right side is packed into
+// GEMM_KC x GEMM_TILE_COLS panels once, before any tile runs, and every row
+// of tiles reuses them, adding into the tile without a product temporary
+// unless the product is scaled. The rest, and matrix-vector products in
+// particular, are row-times-column dot products. A transposed side is copied
+// per tile into unit-stride scratch, never into a full-size matrix.
+template <typename L, typename R>
+class Evaluator<ProductExpr<L, R>> {
+    typedef typename L::Element T;
+
+    ProductChain<T> chain;
+    const MatrixRef<T> left;
+    const MatrixRef<T> right;
+    std::vector<int32_t> packed_right;
+
+    bool _blocked() const {
+        return std::is_same_v<T, int32_t> && right.cols() >= GEMM_NR;
+    }
+
+    // Packed panel of the right side for k block k_begin of tile column
+    // col_begin. Every tile column but the last is GEMM_TILE_COLS wide, a
+    // multiple of GEMM_NR, so panels sit back to back.
+    std::size_t _panel_offset(std::size_t col_begin, std::size_t tile_cols, std::size_t k_begin) const {
+        return col_begin * right.rows() + k_begin * round_up(tile_cols, GEMM_NR);
+    }
+
+    void _pack_right() {
+        const std::size_t depth = right.rows();
+        const std::size_t cols = right.cols();
+        const ConstMatrixView<int32_t> source = right.source().view();
+        packed_right.resize(round_up(cols, GEMM_NR) * depth);
+
+        expression_tile_executor()((cols + GEMM_TILE_COLS - 1) / GEMM_TILE_COLS, [&](std::size_t tile_col) {
+            const std::size_t col_begin = tile_col * GEMM_TILE_COLS;
+            const std::size_t tile_cols = std::min(GEMM_TILE_COLS, cols - col_begin);
+
+            for (std::size_t k_block = 0; k_block < depth; k_block += GEMM_KC) {
+                const std::size_t block_depth = std::min(GEMM_KC, depth - k_block);
+                int32_t* panel = packed_right.data() + _panel_offset(col_begin, tile_cols, k_block);
+
+                if (right.is_transposed())
+                    pack_b_panel_transposed(source, k_block, block_depth, col_begin, tile_cols, panel);
+                else
+                    pack_b_panel(source, k_block, block_depth, col_begin, tile_cols, panel);
+            }
+        });
+    }
+
+    // The tile's rows of the left side, unit-stride.
+    ConstMatrixView<T> _left_rows(const Tile& tile) const {
+        if (!left.is_transposed())
+            return left.source().view().block(tile.row_begin, 0);
+
+        thread_local std::vector<T> rows;
+        const std::size_t depth = left.cols();
+        rows.resize(GEMM_TILE_ROWS * depth);
+
+        for (std::size_t k = 0; k < depth; k++) {
+            const T* values = left.source().row(k) + tile.row_begin;
+            for (std::size_t row = 0; row < tile.row_end - tile.row_begin; row++)
+                rows[row * depth + k] = values[row];
+        }
+
+        return { rows.data(), depth };
+    }
+
+    // The tile's columns of the right side as unit-stride rows.
+    ConstMatrixView<T> _right_cols(const Tile& tile) const {
+        if (right.is_transposed())
+            return right.source().view().block(tile.col_begin, 0);
+
+        thread_local std::vector<T> cols;
+        const std::size_t depth = right.rows();
+        cols.resize(GEMM_TILE_COLS * depth);
+
+        for (std::size_t k = 0; k < depth; k++) {
+            const T* values = right.source().row(k) + tile.col_begin;
+            for (std::size_t col = 0; col < tile.col_end - tile.col_begin; col++)
+                cols[col * depth + k] = values[col];
+        }
+
+        return { cols.data(), depth };
+    }
+
+    // out += left * right over the tile through the packed panels.
+    void _multiply_blocked(const Tile& tile, MatrixView<int32_t> out) const {
+        const std::size_t depth = left.cols();
+        const std::size_t tile_rows = tile.row_end - tile.row_begin;
+        const std::size_t tile_cols = tile.col_end - tile.col_begin;
+        const ConstMatrixView<int32_t> a = _left_rows(tile);
+
+        for (std::size_t k_block = 0; k_block < depth; k_block += GEMM_KC)
+            gemm_packed_panel(tile_rows, tile_cols, k_block, std::min(GEMM_KC, depth - k_block), a,
+                              packed_right.data() + _panel_offset(tile.col_begin, tile_cols, k_block), out);
+    }
+
+    public:
+        explicit Evaluator(const ProductExpr<L, R>& expression)
+            : chain(expression), left(chain.left_side()), right(chain.right_side()) {
+            if constexpr (std::is_same_v<T, int32_t>) {
+                if (_blocked())
+                    _pack_right();
+            }
+        }
+
+        Evaluator(const Evaluator&) = delete;
+
+        void accumulate(T coefficient, const Tile& tile, MatrixView<T> out) const {
+            coefficient *= chain.scale;
+
+            const std::size_t tile_rows = tile.row_end - tile.row_begin;
+            const std::size_t tile_cols = tile.col_end - tile.col_begin;
+
+            if constexpr (std::is_same_v<T, int32_t>) {
+                if (_blocked()) {
+                    if (coefficient == 1) {
+                        _multiply_blocked(tile, out);
+                        return;
+                    }
+
+                    thread_local std::vector<int32_t> product(GEMM_TILE_ROWS * GEMM_TILE_COLS);
+                    std::fill(product.begin(), product.begin() + tile_rows * tile_cols, 0);
+                    _multiply_blocked(tile, { product.data(), tile_cols });
+
+                    for (std::size_t row = 0; row < tile_rows; row++)
+                        for (std::size_t col = 0; col < tile_cols; col++)
+                            out.row(row)[col] += coefficient * product[row * tile_cols + col];
+                    return;
+                }
+            }
+
+            const std::size_t depth = left.cols();
+            const ConstMatrixView<T> a = _left_rows(tile);
+            const ConstMatrixView<T> b = _right_cols(tile);
+
+            for (std::size_t row = 0; row < tile_rows; row++) {
+                T* target = out.row(row);
+
+                for (std::size_t col = 0; col < tile_cols; col++)
+                    target[col] += coefficient * static_cast<T>(dot_product<T>(a.row(row), b.row(col), depth));
+            }
+        }
+};
+
+template <typename E>
+Matrix<typename E::Element> evaluate(const E& expression) {
+    typedef typename E::Element T;
+
+    Matrix<T> result(expression.cols(), expression.rows(), 0);
+    const Evaluator<E> evaluator(expression);
+
+    const MatrixView<T> target = result.view();
+    const std::size_t tiles_per_row = (result.width + GEMM_TILE_COLS - 1) / GEMM_TILE_COLS;
+    const std::size_t tile_count = (result.height + GEMM_TILE_ROWS - 1) / GEMM_TILE_ROWS * tiles_per_row;
+
+    expression_tile_executor()(tile_count, [&](std::size_t tile_index) {
+        const std::size_t row_begin = tile_index / tiles_per_row * GEMM_TILE_ROWS;
+        const std::size_t col_begin = tile_index % tiles_per_row * GEMM_TILE_COLS;
+        const Tile tile = { row_begin, std::min(row_begin + GEMM_TILE_ROWS, result.height),
+                            col_begin, std::min(col_begin + GEMM_TILE_COLS, result.width) };
+
+        evaluator.accumulate(1, tile, target.block(row_begin, col_begin));
+    });
+
+    return result;
+}
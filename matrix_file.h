@@ -0,0 +1,293 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "matrix.h"
+
+// Tiled matrix file:
+//
+//   MatrixFileHeader, zero padding up to data_offset (a page boundary),
+//   then tile_grid_rows x tile_grid_cols tiles in row-major tile order.
+//
+// Every tile is stored whole, tile_rows x tile_cols row-major elements, with
+// the parts past the matrix edge zeroed, so a tile's offset is a product and
+// an edge tile multiplies like any other.
+
+static constexpr char MATRIX_FILE_MAGIC[8] = { 'M', 'A', 'T', 'T', 'I', 'L', 'E', 'S' };
+static constexpr uint32_t MATRIX_FILE_VERSION = 1;
+static constexpr std::size_t MATRIX_FILE_ALIGNMENT = 4096;
+
+enum class ElementType : uint32_t { INT8 = 1, INT16, INT32, INT64, FLOAT, DOUBLE };
+
+template <typename T> struct ElementTypeOf;
+template <> struct ElementTypeOf<int8_t> { static constexpr ElementType value = ElementType::INT8; };
+template <> struct ElementTypeOf<int16_t> { static constexpr ElementType value = ElementType::INT16; };
+template <> struct ElementTypeOf<int32_t> { static constexpr ElementType value = ElementType::INT32; };
+template <> struct ElementTypeOf<int64_t> { static constexpr ElementType value = ElementType::INT64; };
+template <> struct ElementTypeOf<float> { static constexpr ElementType value = ElementType::FLOAT; };
+template <> struct ElementTypeOf<double> { static constexpr ElementType value = ElementType::DOUBLE; };
+
+inline std::size_t element_size(ElementType type) {
+    switch (type) {
+        case ElementType::INT8: return 1;
+        case ElementType::INT16: return 2;
+        case ElementType::INT32: return 4;
+        case ElementType::INT64: return 8;
+        case ElementType::FLOAT: return 4;
+        case ElementType::DOUBLE: return 8;
+    }
+
+    throw std::runtime_error("Unknown element type " + std::to_string(static_cast<uint32_t>(type)));
+}
+
+struct MatrixFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t element_type;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t tile_rows;
+    uint64_t tile_cols;
+    uint64_t data_offset;
+};
+
+// A matrix file mapped whole into the address space. Nothing is read until
+// a tile is touched; prefetch_tile() and release_tile() let a caller keep
+// only the tiles it is working on resident.
+class MappedMatrixFile {
+    private:
+        int fd = -1;
+        void* mapping = nullptr;
+        std::size_t mapping_size = 0;
+        MatrixFileHeader header = {};
+
+        static void _fail(const std::string& what, const std::string& path) {
+            throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+        }
+
+        void _map(const std::string& path, bool writable) {
+            mapping = mmap(nullptr, mapping_size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+            if (mapping == MAP_FAILED) {
+                mapping = nullptr;
+                _fail("Cannot map", path);
+            }
+        }
+
+        std::size_t _tile_bytes() const {
+            return header.tile_rows * header.tile_cols * element_size(static_cast<ElementType>(header.element_type));
+        }
+
+        // Page-aligned range of the tile: outward for prefetching, inward for
+        // releasing so a neighbouring tile's pages are left alone.
+        void _advise_tile(std::size_t tile_row, std::size_t tile_col, int advice, bool inward) const {
+            const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            const std::size_t tile_begin = tile_offset(tile_row, tile_col);
+            const std::size_t tile_end = tile_begin + _tile_bytes();
+
+            const std::size_t range_begin = inward ? round_up(tile_begin, page_size) : tile_begin / page_size * page_size;
+            const std::size_t range_end = inward ? tile_end / page_size * page_size : std::min(round_up(tile_end, page_size), mapping_size);
+            if (range_begin < range_end)
+                madvise(static_cast<char*>(mapping) + range_begin, range_end - range_begin, advice);
+        }
+
+        MappedMatrixFile() = default;
+
+    public:
+        MappedMatrixFile(const MappedMatrixFile&) = delete;
+        MappedMatrixFile& operator=(const MappedMatrixFile&) = delete;
+
+        MappedMatrixFile(MappedMatrixFile&& other)
+            : fd(other.fd), mapping(other.mapping), mapping_size(other.mapping_size), header(other.header) {
+            other.fd = -1;
+            other.mapping = nullptr;
+        }
+
+        ~MappedMatrixFile() {
+            if (mapping)
+                munmap(mapping, mapping_size);
+            if (fd >= 0)
+                close(fd);
+        }
+
+        // Creates (or truncates) a zero-filled file; the file system only
+        // allocates the tiles that get written.
+        static MappedMatrixFile create(const std::string& path, ElementType type, std::size_t rows, std::size_t cols,
+                                       std::size_t tile_rows, std::size_t tile_cols) {
+            if (rows == 0 || cols == 0 || tile_rows == 0 || tile_cols == 0)
+                throw std::runtime_error("Empty matrix or tile for " + path);
+
+            MappedMatrixFile file;
+            std::memcpy(file.header.magic, MATRIX_FILE_MAGIC, sizeof(MATRIX_FILE_MAGIC));
+            file.header.version = MATRIX_FILE_VERSION;
+            file.header.element_type = static_cast<uint32_t>(type);
+            file.header.rows = rows;
+            file.header.cols = cols;
+            file.header.tile_rows = tile_rows;
+            file.header.tile_cols = tile_cols;
+            file.header.data_offset = round_up(sizeof(MatrixFileHeader), MATRIX_FILE_ALIGNMENT);
+            file.mapping_size = file.header.data_offset + file.tile_grid_rows() * file.tile_grid_cols() * file._tile_bytes();
+
+            file.fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (file.fd < 0)
+                _fail("Cannot create", path);
+            if (ftruncate(file.fd, static_cast<off_t>(file.mapping_size)) != 0)
+                _fail("Cannot size", path);
+
+            file._map(path, true);
+            std::memcpy(file.mapping, &file.header, sizeof(MatrixFileHeader));
+
+            return file;
+        }
+
+        static MappedMatrixFile open(const std::string& path, bool writable = false) {
+            MappedMatrixFile file;
+
+            file.fd = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+            if (file.fd < 0)
+                _fail("Cannot open", path);
+
+            struct stat file_stat;
+            if (fstat(file.fd, &file_stat) != 0)
+                _fail("Cannot stat", path);
+            if (static_cast<std::size_t>(file_stat.st_size) < sizeof(MatrixFileHeader))
+                throw std::runtime_error("Not a matrix file: " + path);
+
+            file.mapping_size = static_cast<std::size_t>(file_stat.st_size);
+            file._map(path, writable);
+            std::memcpy(&file.header, file.mapping, sizeof(MatrixFileHeader));
+
+            if (std::memcmp(file.header.magic, MATRIX_FILE_MAGIC, sizeof(MATRIX_FILE_MAGIC)) != 0)
+                throw std::runtime_error("Not a matrix file: " + path);
+            if (file.header.version != MATRIX_FILE_VERSION)
+                throw std::runtime_error("Unsupported matrix file version " + std::to_string(file.header.version) + ": " + path);
+            if (file.header.tile_rows == 0 || file.header.tile_cols == 0 || file.header.data_offset
+                    + file.tile_grid_rows() * file.tile_grid_cols() * file._tile_bytes() > file.mapping_size)
+                throw std::runtime_error("Truncated matrix file: " + path);
+
+            return file;
+        }
+
+        ElementType element_type() const {
+            return static_cast<ElementType>(header.element_type);
+        }
+
+        std::size_t rows() const {
+            return header.rows;
+        }
+
+        std::size_t cols() const {
+            return header.cols;
+        }
+
+        std::size_t tile_rows() const {
+            return header.tile_rows;
+        }
+
+        std::size_t tile_cols() const {
+            return header.tile_cols;
+        }
+
+        std::size_t tile_grid_rows() const {
+            return (header.rows + header.tile_rows - 1) / header.tile_rows;
+        }
+
+        std::size_t tile_grid_cols() const {
+            return (header.cols + header.tile_cols - 1) / header.tile_cols;
+        }
+
+        std::size_t tile_offset(std::size_t tile_row, std::size_t tile_col) const {
+            return header.data_offset + (tile_row * tile_grid_cols() + tile_col) * _tile_bytes();
+        }
+
+        // Tile (tile_row, tile_col) as a tile_rows x tile_cols row-major block.
+        template <typename T>
+        const T* tile(std::size_t tile_row, std::size_t tile_col) const {
+            if (ElementTypeOf<T>::value != element_type())
+                throw std::runtime_error("Matrix file holds another element type");
+
+            return reinterpret_cast<const T*>(static_cast<const char*>(mapping) + tile_offset(tile_row, tile_col));
+        }
+
+        template <typename T>
+        T* tile(std::size_t tile_row, std::size_t tile_col) {
+            return const_cast<T*>(static_cast<const MappedMatrixFile*>(this)->tile<T>(tile_row, tile_col));
+        }
+
+        template <typename T>
+        T get(std::size_t row_index, std::size_t col_index) const {
+            const T* block = tile<T>(row_index / header.tile_rows, col_index / header.tile_cols);
+
+            return block[(row_index % header.tile_rows) * header.tile_cols + col_index % header.tile_cols];
+        }
+
+        // Asks the kernel to start reading the tile in the background.
+        void prefetch_tile(std::size_t tile_row, std::size_t tile_col) const {
+            _advise_tile(tile_row, tile_col, MADV_WILLNEED, false);
+        }
+
+        // Faults the tile in by reading a byte per page, so a prefetch thread
+        // can pay the I/O instead of the thread that multiplies the tile.
+        void touch_tile(std::size_t tile_row, std::size_t tile_col) const {
+            const std::size_t page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+            const volatile char* block = static_cast<const char*>(mapping) + tile_offset(tile_row, tile_col);
+
+            char sink = 0;
+            for (std::size_t offset = 0; offset < _tile_bytes(); offset += page_size)
+                sink ^= block[offset];
+            (void) sink;
+        }
+
+        // Drops the tile's pages from this mapping. Written data stays in the
+        // page cache and reaches the file; the pages become reclaimable
+        // instead of counting against the process.
+        void release_tile(std::size_t tile_row, std::size_t tile_col) const {
+            _advise_tile(tile_row, tile_col, MADV_DONTNEED, true);
+        }
+
+        void flush() const {
+            if (msync(mapping, mapping_size, MS_SYNC) != 0)
+                throw std::runtime_error(std::string("Cannot flush matrix file: ") + std::strerror(errno));
+        }
+};
+
+template <typename T>
+void write_matrix_file(const std::string& path, const Matrix<T>& matrix, std::size_t tile_rows, std::size_t tile_cols) {
+    MappedMatrixFile file = MappedMatrixFile::create(path, ElementTypeOf<T>::value, matrix.height, matrix.width,
+            tile_rows, tile_cols);
+
+    for (std::size_t tile_row = 0; tile_row < file.tile_grid_rows(); tile_row++)
+        for (std::size_t tile_col = 0; tile_col < file.tile_grid_cols(); tile_col++) {
+            T* block = file.tile<T>(tile_row, tile_col);
+            const std::size_t row_begin = tile_row * tile_rows;
+            const std::size_t col_begin = tile_col * tile_cols;
+            const std::size_t valid_cols = std::min(tile_cols, matrix.width - col_begin);
+
+            for (std::size_t row = 0; row < std::min(tile_rows, matrix.height - row_begin); row++)
+                std::copy(matrix.row(row_begin + row) + col_begin, matrix.row(row_begin + row) + col_begin + valid_cols,
+                        block + row * tile_cols);
+        }
+
+    file.flush();
+}
+
+template <typename T>
+Matrix<T> read_matrix_file(const std::string& path) {
+    const MappedMatrixFile file = MappedMatrixFile::open(path);
+
+    Matrix<T> matrix(file.cols(), file.rows());
+    for (std::size_t row_index = 0; row_index < file.rows(); row_index++)
+        for (std::size_t col_index = 0; col_index < file.cols(); col_index++)
+            matrix.set(row_index, col_index, file.get<T>(row_index, col_index));
+
+    return matrix;
+}
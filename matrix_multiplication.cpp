@@ -1,184 +1,466 @@
 #include <vector>
-#include <unordered_map>
-#include <set>
 #include <iostream>
 #include <cassert>
 #include <functional>
 #include <thread>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+#include <random>
+#include <future>
+#include <tuple>
+#include <stdexcept>
+#include <string>
+#include <map>
+#include <type_traits>
+#include <filesystem>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <sys/resource.h>
 
 #include <boost/asio/thread_pool.hpp>
 #include <boost/asio/post.hpp>
 
+#include "matrix.h"
+#include "sparse_matrix.h"
+#include "matrix_file.h"
+#include "matrix_expression.h"
+
 static constexpr unsigned int TASK_COUNT = 10;
 static constexpr unsigned int THREAD_POOL_SIZE = 5;
 
-class Matrix {
-    private:
-        std::unordered_map<std::size_t, std::vector<int32_t>> col_cache;
+// Strassen-Winograd recurses down to blocks of at most this size, which then
+// go to the blocked kernel.
+static constexpr std::size_t DEFAULT_STRASSEN_CUTOFF = 512;
+static constexpr std::size_t STRASSEN_PRODUCT_COUNT = 7;
+static constexpr std::size_t STRASSEN_TUNE_SIZE = 2048;
 
-    public:
-        std::vector<std::vector<int32_t>> rows;
-        const std::size_t width;
-        const std::size_t height;
+static constexpr std::size_t GEMM_BENCH_NAIVE_MAX_SIZE = 1024;
+static constexpr std::size_t GEMM_BENCH_SAMPLES = 64;
+static constexpr std::size_t SCALING_BENCH_SIZE = 2048;
+static constexpr std::size_t SPARSE_BENCH_SIZE = 2048;
+static constexpr std::size_t EXPRESSION_BENCH_SIZE = 2048;
+static constexpr std::size_t DEFAULT_BENCH_SIZE = 500;
+static constexpr std::size_t DEFAULT_BENCH_TRIALS = 3;
 
-        Matrix(std::vector<std::vector<int32_t>>&& rows)
-            : rows(rows), width(rows[0].size()), height(rows.size()) {
-        }
+// Square tiles of the files the out-of-core mode writes: 4MB of int32 each.
+static constexpr std::size_t DEFAULT_OUT_OF_CORE_TILE = 1024;
 
-        Matrix(std::size_t width, std::size_t height, int32_t value = 0) 
-            : rows(height, std::vector<int32_t>(width, value)), width(width), height(height) {}
+// Smallest run of rows a sparse task hands to another thread.
+static constexpr std::size_t SPARSE_ROW_GRAIN = 16;
 
-        const std::vector<int32_t>& get_row(std::size_t row_index) const {
-            return rows.at(row_index);
-        }
+// Accumulates A * B into the tile of result (which must start zeroed).
+void multiply_tile_blocked(const Matrix<int32_t>& A, const Matrix<int32_t>& B, Matrix<int32_t>& result, const Tile& tile) {
+    assert(A.width == B.height);
 
-        void set(std::size_t row_index, std::size_t col_index, int32_t value) {
-            rows[row_index][col_index] = value;
-        }
+    gemm_blocked(tile.row_end - tile.row_begin, tile.col_end - tile.col_begin, A.width,
+            A.view().block(tile.row_begin, 0), B.view().block(0, tile.col_begin), 
+            result.view().block(tile.row_begin, tile.col_begin));
+}
 
-        std::vector<int32_t> get_col(std::size_t col_index) const {
-            std::vector<int32_t> col;
-            col.reserve(height);
-            for (const auto& row : rows)
-                col.push_back(row.at(col_index));
+void fill_block(std::size_t size, MatrixView<int32_t> Z, int32_t value) {
+    for (std::size_t row_index = 0; row_index < size; row_index++)
+        std::fill(Z.row(row_index), Z.row(row_index) + size, value);
+}
 
-            return col;
-        }
-};
+// Z = X + Y, wrapping on overflow like the blocked kernel; Z may alias X or Y.
+void add_blocks(std::size_t size, ConstMatrixView<int32_t> X, ConstMatrixView<int32_t> Y, MatrixView<int32_t> Z) {
+    for (std::size_t row_index = 0; row_index < size; row_index++) {
+        const int32_t* x = X.row(row_index);
+        const int32_t* y = Y.row(row_index);
+        int32_t* z = Z.row(row_index);
 
-int32_t dot_product(const std::vector<int32_t>& a, const std::vector<int32_t>& b) {
-    assert(a.size() == b.size());
+        for (std::size_t col_index = 0; col_index < size; col_index++)
+            z[col_index] = wrapping_add(x[col_index], y[col_index]);
+    }
+}
 
-    int32_t result = 0;
-    for (std::size_t index = 0; index < a.size(); index++)
-        result += a[index] * b[index];
+// Z = X - Y, wrapping on overflow; Z may alias X or Y.
+void sub_blocks(std::size_t size, ConstMatrixView<int32_t> X, ConstMatrixView<int32_t> Y, MatrixView<int32_t> Z) {
+    for (std::size_t row_index = 0; row_index < size; row_index++) {
+        const int32_t* x = X.row(row_index);
+        const int32_t* y = Y.row(row_index);
+        int32_t* z = Z.row(row_index);
 
-    return result;
+        for (std::size_t col_index = 0; col_index < size; col_index++)
+            z[col_index] = wrapping_sub(x[col_index], y[col_index]);
+    }
 }
 
-int32_t compute_element(std::size_t row_index, std::size_t col_index,
-                        const Matrix& A, const Matrix& B) {
-    assert(A.width == B.height);
+// Scratch needed by strassen_winograd: two half-size temporaries per level.
+std::size_t strassen_scratch_size(std::size_t size, std::size_t cutoff) {
+    if (size <= cutoff || size % 2)
+        return 0;
+
+    const std::size_t half = size / 2;
+
+    return 2 * half * half + strassen_scratch_size(half, cutoff);
+}
+
+// C = A * B for size x size views with the Winograd variant of Strassen
+// (7 products, 15 additions). The schedule of Boyer, Dumas, Pernet and Zhou
+// keeps every intermediate in the quadrants of C plus two temporaries X and
+// Y, so a level needs only 2 (size / 2)^2 of the preallocated scratch.
+void strassen_winograd(std::size_t size, ConstMatrixView<int32_t> A, ConstMatrixView<int32_t> B, MatrixView<int32_t> C, 
+                       int32_t* scratch, std::size_t cutoff) {
+    if (size <= cutoff || size % 2) {
+        fill_block(size, C, 0);
+        gemm_blocked(size, size, size, A, B, C);
+        return;
+    }
+
+    const std::size_t h = size / 2;
+    const MatrixView<int32_t> X = { scratch, h };
+    const MatrixView<int32_t> Y = { scratch + h * h, h };
+    int32_t* next_scratch = scratch + 2 * h * h;
+
+    const ConstMatrixView<int32_t> A11 = A, A12 = A.block(0, h), A21 = A.block(h, 0), A22 = A.block(h, h);
+    const ConstMatrixView<int32_t> B11 = B, B12 = B.block(0, h), B21 = B.block(h, 0), B22 = B.block(h, h);
+    const MatrixView<int32_t> C11 = C, C12 = C.block(0, h), C21 = C.block(h, 0), C22 = C.block(h, h);
+
+    sub_blocks(h, A11, A21, X);                                 // S3
+    sub_blocks(h, B22, B12, Y);                                 // T3
+    strassen_winograd(h, X, Y, C21, next_scratch, cutoff);      // P7 = S3 T3
+    add_blocks(h, A21, A22, X);                                 // S1
+    sub_blocks(h, B12, B11, Y);                                 // T1
+    strassen_winograd(h, X, Y, C22, next_scratch, cutoff);      // P5 = S1 T1
+    sub_blocks(h, X, A11, X);                                   // S2
+    sub_blocks(h, B22, Y, Y);                                   // T2
+    strassen_winograd(h, X, Y, C12, next_scratch, cutoff);      // P6 = S2 T2
+    sub_blocks(h, A12, X, X);                                   // S4
+    strassen_winograd(h, X, B22, C11, next_scratch, cutoff);    // P3 = S4 B22
+    strassen_winograd(h, A11, B11, X, next_scratch, cutoff);    // P1
+    add_blocks(h, X, C12, C12);                                 // U2 = P1 + P6
+    add_blocks(h, C12, C21, C21);                               // U3 = U2 + P7
+    add_blocks(h, C12, C22, C12);                               // U4 = U2 + P5
+    add_blocks(h, C21, C22, C22);                               // C22 = U3 + P5
+    add_blocks(h, C12, C11, C12);                               // C12 = U4 + P3
+    sub_blocks(h, Y, B21, Y);                                   // T4 = T2 - B21
+    strassen_winograd(h, A22, Y, C11, next_scratch, cutoff);    // P4 = A22 T4
+    sub_blocks(h, C21, C11, C21);                               // C21 = U3 - P4
+    strassen_winograd(h, A12, B21, C11, next_scratch, cutoff);  // P2
+    add_blocks(h, X, C11, C11);                                 // C11 = P1 + P2
+}
+
+boost::asio::thread_pool& strassen_pool() {
+    static boost::asio::thread_pool pool(STRASSEN_PRODUCT_COUNT);
+    return pool;
+}
+
+// Top level of the recursion with the seven products running in parallel on
+// a process-wide pool. They need separate operands and outputs, so this level
+// keeps S1-S4, T1-T4 and three products in scratch; the other four products
+// land in the quadrants of C. Every product then recurses sequentially in
+// its own slice of one preallocated buffer.
+void strassen_winograd_parallel(std::size_t size, ConstMatrixView<int32_t> A, ConstMatrixView<int32_t> B, MatrixView<int32_t> C, 
+                                std::size_t cutoff) {
+    if (size <= cutoff || size % 2) {
+        fill_block(size, C, 0);
+        gemm_blocked(size, size, size, A, B, C);
+        return;
+    }
+
+    const std::size_t h = size / 2;
+    const std::size_t block_size = h * h;
+    const std::size_t product_scratch_size = strassen_scratch_size(h, cutoff);
+
+    std::vector<int32_t> scratch(11 * block_size + STRASSEN_PRODUCT_COUNT * product_scratch_size);
+    std::vector<MatrixView<int32_t>> blocks;
+    for (std::size_t block_index = 0; block_index < 11; block_index++)
+        blocks.push_back({ scratch.data() + block_index * block_size, h });
 
-    return dot_product(A.get_row(row_index), B.get_col(col_index));
+    const MatrixView<int32_t> S1 = blocks[0], S2 = blocks[1], S3 = blocks[2], S4 = blocks[3];
+    const MatrixView<int32_t> T1 = blocks[4], T2 = blocks[5], T3 = blocks[6], T4 = blocks[7];
+    const MatrixView<int32_t> P1 = blocks[8], P5 = blocks[9], P6 = blocks[10];
+
+    const ConstMatrixView<int32_t> A11 = A, A12 = A.block(0, h), A21 = A.block(h, 0), A22 = A.block(h, h);
+    const ConstMatrixView<int32_t> B11 = B, B12 = B.block(0, h), B21 = B.block(h, 0), B22 = B.block(h, h);
+    const MatrixView<int32_t> C11 = C, C12 = C.block(0, h), C21 = C.block(h, 0), C22 = C.block(h, h);
+
+    add_blocks(h, A21, A22, S1);
+    sub_blocks(h, S1, A11, S2);
+    sub_blocks(h, A11, A21, S3);
+    sub_blocks(h, A12, S2, S4);
+    sub_blocks(h, B12, B11, T1);
+    sub_blocks(h, B22, T1, T2);
+    sub_blocks(h, B22, B12, T3);
+    sub_blocks(h, T2, B21, T4);
+
+    const std::vector<std::tuple<ConstMatrixView<int32_t>, ConstMatrixView<int32_t>, MatrixView<int32_t>>> products = {
+        { A11, B11, P1 }, { A12, B21, C11 }, { S4, B22, C12 }, { A22, T4, C21 },
+        { S1, T1, P5 }, { S2, T2, P6 }, { S3, T3, C22 } };
+
+    std::vector<std::future<void>> finished;
+    for (std::size_t product_index = 0; product_index < products.size(); product_index++) {
+        const auto [lhs, rhs, product] = products[product_index];
+        int32_t* product_scratch = scratch.data() + 11 * block_size + product_index * product_scratch_size;
+
+        auto job = std::make_shared<std::packaged_task<void()>>([=]() {
+            strassen_winograd(h, lhs, rhs, product, product_scratch, cutoff);
+        });
+        finished.push_back(job->get_future());
+        boost::asio::post(strassen_pool(), [job]() { (*job)(); });
+    }
+
+    for (auto& product : finished)
+        product.get();
+
+    add_blocks(h, C11, P1, C11);    // C11 = P2 + P1
+    add_blocks(h, P6, P1, P6);      // U2 = P1 + P6
+    add_blocks(h, C12, P6, C12);    // P3 + U2
+    add_blocks(h, C12, P5, C12);    // C12 = U4 + P3
+    add_blocks(h, C22, P6, C22);    // U3 = U2 + P7
+    sub_blocks(h, C22, C21, C21);   // C21 = U3 - P4
+    add_blocks(h, C22, P5, C22);    // C22 = U3 + P5
 }
 
+// Square and non-square products are zero-padded to cutoff-or-less times a
+// power of two, so every level halves evenly.
+Matrix<int32_t> multiply_matrix_strassen(const Matrix<int32_t>& A, const Matrix<int32_t>& B, std::size_t cutoff = DEFAULT_STRASSEN_CUTOFF) {
+    assert(A.width == B.height);
 
-class Task {
-    const Matrix& A;
-    const Matrix& B;
+    std::size_t leaf_size = std::max({ A.height, A.width, B.width });
+    std::size_t levels = 0;
+    while (leaf_size > cutoff) {
+        leaf_size = (leaf_size + 1) / 2;
+        levels++;
+    }
+    const std::size_t padded_size = leaf_size << levels;
 
-    Matrix& result;
+    Matrix<int32_t> result(B.width, A.height, 0);
+    if (levels == 0) {
+        gemm_blocked(A.height, B.width, A.width, A.view(), B.view(), result.view());
+        return result;
+    }
 
+    if (A.height == padded_size && A.width == padded_size && B.width == padded_size) {
+        strassen_winograd_parallel(padded_size, A.view(), B.view(), result.view(), cutoff);
+        return result;
+    }
+
+    Matrix<int32_t> padded_a(padded_size, padded_size, 0);
+    Matrix<int32_t> padded_b(padded_size, padded_size, 0);
+    Matrix<int32_t> padded_result(padded_size, padded_size, 0);
+
+    for (std::size_t row_index = 0; row_index < A.height; row_index++)
+        std::copy(A.row(row_index), A.row(row_index) + A.width, padded_a.row(row_index));
+    for (std::size_t row_index = 0; row_index < B.height; row_index++)
+        std::copy(B.row(row_index), B.row(row_index) + B.width, padded_b.row(row_index));
+
+    strassen_winograd_parallel(padded_size, padded_a.view(), padded_b.view(), padded_result.view(), cutoff);
+
+    for (std::size_t row_index = 0; row_index < result.height; row_index++)
+        std::copy(padded_result.row(row_index), padded_result.row(row_index) + result.width, result.row(row_index));
+
+    return result;
+}
+
+// What the executors schedule: size() indices whose slices may run
+// concurrently.
+class RangeTask {
     public:
-        std::set<std::pair<std::size_t, std::size_t>> requested_indices;
-        Task(const Matrix& A, const Matrix& B, Matrix& result) :
-            A(A), B(B), result(result) {}
+        virtual ~RangeTask() = default;
+
+        virtual std::size_t size() const = 0;
+        virtual std::size_t default_grain() const = 0;
+        virtual void execute_slice(std::size_t first, std::size_t count) const = 0;
 
-        void request_element(std::size_t row_index, std::size_t col_index) {
-            requested_indices.insert({row_index, col_index});
+        void execute() const {
+            execute_slice(0, size());
         }
+};
+
+enum class TaskUnit { ELEMENT, TILE };
+enum class TaskOrder { ROW_MAJOR, COL_MAJOR };
+
+// A task is a strided range of linear indices over the result's elements
+// (in row- or column-major order) or over its GEMM_TILE_ROWS x
+// GEMM_TILE_COLS tiles (row-major), so it takes the same few words whatever
+// the matrix size. Contiguous row or column ranges use stride 1, the k-th
+// strategy uses stride TASK_COUNT. Elements of type T are multiplied and
+// summed in Acc, which is also the result's element type; tiles go through
+// the int32 blocked kernel, so they need T and Acc to be int32.
+template <typename T, typename Acc = DefaultAccumulator<T>>
+class Task : public RangeTask {
+    static constexpr bool HAS_BLOCKED_KERNEL = std::is_same_v<T, int32_t> && std::is_same_v<Acc, int32_t>;
+
+    const Matrix<T>& A;
+    const Matrix<T>& B;
+
+    Matrix<Acc>& result;
 
-        void compute_and_write_element(std::size_t row_index, std::size_t col_index) {
-            result.rows[row_index][col_index] = compute_element(row_index, col_index, A, B);
+    TaskUnit unit;
+    TaskOrder order;
+    std::size_t begin;
+    std::size_t end;
+    std::size_t stride;
+
+    // Walks [range_begin, range_end) without dividing per element: the minor
+    // coordinate is advanced by the stride and carried into the major one.
+    template <typename Visit>
+    void _for_each_index(std::size_t range_begin, std::size_t range_end, std::size_t minor_size, Visit visit) const {
+        if (range_begin >= range_end)
+            return;
+
+        std::size_t major = range_begin / minor_size;
+        std::size_t minor = range_begin % minor_size;
+
+        for (std::size_t index = range_begin; index < range_end; index += stride) {
+            visit(major, minor);
+
+            minor += stride;
+            while (minor >= minor_size) {
+                minor -= minor_size;
+                major++;
+            }
         }
+    }
 
-        void execute() {
-            for (auto &[row_index, col_index]: requested_indices)
-                compute_and_write_element(row_index, col_index);
+    public:
+        Task(const Matrix<T>& A, const Matrix<T>& B, Matrix<Acc>& result, TaskUnit unit, TaskOrder order,
+             std::size_t begin, std::size_t end, std::size_t stride = 1) :
+            A(A), B(B), result(result), unit(unit), order(order), begin(begin), end(end), stride(stride) {
+            assert(unit == TaskUnit::ELEMENT || HAS_BLOCKED_KERNEL);
         }
-};
 
-std::vector<Task> multiply_matrix_row_tasks(const Matrix& A, const Matrix& B, Matrix& result) {
-        std::vector<Task> tasks(TASK_COUNT, Task(A, B, result));
+        void compute_and_write_element(std::size_t row_index, std::size_t col_index) const {
+            result.set(row_index, col_index, compute_element<T, Acc>(row_index, col_index, A, B));
+        }
 
-        std::size_t elements_computed = A.height * B.width;
-        std::size_t op_per_task = elements_computed / TASK_COUNT;
-        int remainder = elements_computed % TASK_COUNT;
+        // Number of indices (elements or tiles) in the range.
+        std::size_t size() const override {
+            return begin < end ? (end - begin + stride - 1) / stride : 0;
+        }
 
-        std::size_t op_index = 0;
-        std::size_t current_task_index = 0;
+        // Smallest slice worth handing to another thread: one tile, or about
+        // a row's worth of elements.
+        std::size_t default_grain() const override {
+            return unit == TaskUnit::TILE ? 1 : std::max<std::size_t>(result.width, 1);
+        }
 
-        for (std::size_t row_index = 0; row_index < result.height; row_index++)
-            for (std::size_t col_index = 0; col_index < result.width; col_index++, op_index++) {
-                if (op_index == op_per_task) {
-                    op_index = -1;
-                    if (remainder > 0) {
-                        tasks[current_task_index++].request_element(row_index, col_index);
-                        remainder--;
+        // Runs indices [first, first + count) of the range; slices of one task
+        // may run concurrently since they write disjoint elements.
+        void execute_slice(std::size_t first, std::size_t count) const override {
+            const std::size_t range_begin = begin + first * stride;
+            const std::size_t range_end = std::min(end, range_begin + count * stride);
 
-                        continue;
-                    }
-                    current_task_index++;
-                }
+            if constexpr (HAS_BLOCKED_KERNEL) {
+                if (unit == TaskUnit::TILE) {
+                    const std::size_t tiles_per_row = (result.width + GEMM_TILE_COLS - 1) / GEMM_TILE_COLS;
 
-                tasks[current_task_index].request_element(row_index, col_index);
+                    _for_each_index(range_begin, range_end, tiles_per_row, [this](std::size_t tile_row, std::size_t tile_col) {
+                        const std::size_t row_index = tile_row * GEMM_TILE_ROWS;
+                        const std::size_t col_index = tile_col * GEMM_TILE_COLS;
+
+                        multiply_tile_blocked(A, B, result, { row_index, std::min(row_index + GEMM_TILE_ROWS, result.height),
+                                col_index, std::min(col_index + GEMM_TILE_COLS, result.width) });
+                    });
+                    return;
+                }
             }
 
-        return tasks;
-}
+            if (order == TaskOrder::ROW_MAJOR)
+                _for_each_index(range_begin, range_end, result.width, [this](std::size_t row_index, std::size_t col_index) {
+                    compute_and_write_element(row_index, col_index);
+                });
+            else
+                _for_each_index(range_begin, range_end, result.height, [this](std::size_t col_index, std::size_t row_index) {
+                    compute_and_write_element(row_index, col_index);
+                });
+        }
+};
 
-std::vector<Task> multiply_matrix_kth_tasks(const Matrix& A, const Matrix& B, Matrix& result) {
-        std::vector<Task> tasks(TASK_COUNT, Task(A, B, result));
+// Splits count items into TASK_COUNT contiguous ranges whose sizes differ
+// by at most one.
+template <typename T, typename Acc = DefaultAccumulator<T>>
+std::vector<Task<T, Acc>> split_into_tasks(const Matrix<T>& A, const Matrix<T>& B, Matrix<Acc>& result, 
+                                   TaskUnit unit, TaskOrder order, std::size_t count) {
+        std::vector<Task<T, Acc>> tasks;
+        tasks.reserve(TASK_COUNT);
 
-        std::size_t op_index = 0;
-        for (std::size_t row_index = 0; row_index < result.height; row_index++)
-            for (std::size_t col_index = 0; col_index < result.width; col_index++, op_index++)
-                tasks[op_index % TASK_COUNT].request_element(row_index, col_index);
+        const std::size_t op_per_task = count / TASK_COUNT;
+        const std::size_t remainder = count % TASK_COUNT;
+
+        std::size_t begin = 0;
+        for (std::size_t task_index = 0; task_index < TASK_COUNT; task_index++) {
+            const std::size_t end = begin + op_per_task + (task_index < remainder ? 1 : 0);
+
+            tasks.emplace_back(A, B, result, unit, order, begin, end);
+            begin = end;
+        }
 
         return tasks;
 }
 
-std::vector<Task> multiply_matrix_col_tasks(const Matrix& A, const Matrix& B, Matrix& result) {
-        std::vector<Task> tasks(TASK_COUNT, Task(A, B, result));
+template <typename T, typename Acc = DefaultAccumulator<T>>
+std::vector<Task<T, Acc>> multiply_matrix_row_tasks(const Matrix<T>& A, const Matrix<T>& B, Matrix<Acc>& result) {
+        return split_into_tasks<T, Acc>(A, B, result, TaskUnit::ELEMENT, TaskOrder::ROW_MAJOR, result.height * result.width);
+}
 
-        std::size_t elements_computed = A.height * B.width;
-        std::size_t op_per_task = elements_computed / TASK_COUNT;
-        int remainder = elements_computed % TASK_COUNT;
+template <typename T, typename Acc = DefaultAccumulator<T>>
+std::vector<Task<T, Acc>> multiply_matrix_kth_tasks(const Matrix<T>& A, const Matrix<T>& B, Matrix<Acc>& result) {
+        std::vector<Task<T, Acc>> tasks;
+        tasks.reserve(TASK_COUNT);
 
-        std::size_t op_index = 0;
-        std::size_t current_task_index = 0;
+        for (std::size_t task_index = 0; task_index < TASK_COUNT; task_index++)
+            tasks.emplace_back(A, B, result, TaskUnit::ELEMENT, TaskOrder::ROW_MAJOR, 
+                    task_index, result.height * result.width, TASK_COUNT);
 
-        for (std::size_t col_index = 0; col_index < result.width; col_index++)
-            for (std::size_t row_index = 0; row_index < result.height; row_index++, op_index++) {
-                if (op_index == op_per_task) {
-                    op_index = -1;
-                    if (remainder > 0) {
-                        tasks[current_task_index++].request_element(row_index, col_index);
-                        remainder--;
+        return tasks;
+}
 
-                        continue;
-                    }
-                    current_task_index++;
-                }
+template <typename T, typename Acc = DefaultAccumulator<T>>
+std::vector<Task<T, Acc>> multiply_matrix_col_tasks(const Matrix<T>& A, const Matrix<T>& B, Matrix<Acc>& result) {
+        return split_into_tasks<T, Acc>(A, B, result, TaskUnit::ELEMENT, TaskOrder::COL_MAJOR, result.height * result.width);
+}
 
-                tasks[current_task_index].request_element(row_index, col_index);
-            }
+// Deals output tiles round-robin, so every task gets a share of the rows and
+// columns and the blocked kernel does the arithmetic.
+std::vector<Task<int32_t, int32_t>> multiply_matrix_blocked_tasks(const Matrix<int32_t>& A, const Matrix<int32_t>& B, Matrix<int32_t>& result) {
+        std::vector<Task<int32_t, int32_t>> tasks;
+        tasks.reserve(TASK_COUNT);
+
+        const std::size_t tile_count = ((result.height + GEMM_TILE_ROWS - 1) / GEMM_TILE_ROWS) 
+            * ((result.width + GEMM_TILE_COLS - 1) / GEMM_TILE_COLS);
+
+        for (std::size_t task_index = 0; task_index < TASK_COUNT; task_index++)
+            tasks.emplace_back(A, B, result, TaskUnit::TILE, TaskOrder::ROW_MAJOR, task_index, tile_count, TASK_COUNT);
 
         return tasks;
 }
 
-typedef std::function<std::vector<Task>(const Matrix&, const Matrix&, Matrix&)> TaskGenerator;
-typedef std::function<Matrix(const Matrix&, const Matrix&, TaskGenerator)> MatrixMultiply;
+template <typename T, typename Acc = DefaultAccumulator<T>>
+using TaskGenerator = std::function<std::vector<Task<T, Acc>>(const Matrix<T>&, const Matrix<T>&, Matrix<Acc>&)>;
+template <typename T, typename Acc = DefaultAccumulator<T>>
+using MatrixMultiply = std::function<Matrix<Acc>(const Matrix<T>&, const Matrix<T>&, TaskGenerator<T, Acc>)>;
 
-Matrix multiply_matrix_seq(const Matrix& A, const Matrix& B, TaskGenerator task_generator) {
-    Matrix result(A.width, B.height, 0);
+template <typename T, typename Acc = DefaultAccumulator<T>>
+Matrix<Acc> multiply_matrix_seq(const Matrix<T>& A, const Matrix<T>& B, TaskGenerator<T, Acc> task_generator) {
+    Matrix<Acc> result(B.width, A.height, 0);
 
     auto tasks = task_generator(A, B, result);
-    for (auto task : tasks)
+    for (auto &task : tasks)
         task.execute();
 
     return result;
 }
 
-Matrix multiply_matrix_thread(const Matrix& A, const Matrix& B, TaskGenerator task_generator) {
-    Matrix result(A.width, B.height, 0);
+template <typename T, typename Acc = DefaultAccumulator<T>>
+Matrix<Acc> multiply_matrix_thread(const Matrix<T>& A, const Matrix<T>& B, TaskGenerator<T, Acc> task_generator) {
+    Matrix<Acc> result(B.width, A.height, 0);
     std::vector<std::thread> threads;
     threads.reserve(TASK_COUNT);
 
     auto tasks = task_generator(A, B, result);
     for (auto &task : tasks)
-        threads.emplace_back(&Task::execute, task);
+        threads.emplace_back(&Task<T, Acc>::execute, task);
 
     for (auto &thread : threads)
         thread.join();
@@ -186,79 +468,1360 @@ Matrix multiply_matrix_thread(const Matrix& A, const Matrix& B, TaskGenerator ta
     return result;
 }
 
-double multiply_matrix_pool(const Matrix& A, const Matrix& B, TaskGenerator task_generator) {
+template <typename T, typename Acc = DefaultAccumulator<T>>
+Matrix<Acc> multiply_matrix_pool(const Matrix<T>& A, const Matrix<T>& B, TaskGenerator<T, Acc> task_generator) {
     boost::asio::thread_pool pool(THREAD_POOL_SIZE);
-    const auto t_start = std::chrono::high_resolution_clock::now();
 
-    Matrix result(A.width, B.height, 0);
+    Matrix<Acc> result(B.width, A.height, 0);
     auto tasks = task_generator(A, B, result);
 
     for (auto &task : tasks)
-        boost::asio::post(pool, std::bind(&Task::execute, task));
+        boost::asio::post(pool, std::bind(&Task<T, Acc>::execute, task));
 
     pool.join();
 
-    const auto t_end = std::chrono::high_resolution_clock::now();
+    return result;
+}
 
-    return std::chrono::duration<double, std::milli>(t_end - t_start).count();
+struct SchedulerOptions {
+    // 0 picks std::thread::hardware_concurrency().
+    unsigned int thread_count = 0;
+    // Smallest slice of a task handed out; 0 uses Task::default_grain().
+    std::size_t grain_size = 0;
+    bool pin_threads = false;
+};
+
+struct TaskChunk {
+    const RangeTask* task;
+    std::size_t first;
+    std::size_t count;
+};
+
+// Per-thread deque of task chunks. The owner works from the back, thieves
+// take the oldest (and usually largest) chunk from the front.
+class SchedulerWorker {
+    private:
+        std::mutex mutex;
+        std::deque<TaskChunk> chunks;
+
+    public:
+        void push_back(const TaskChunk& chunk) {
+            std::lock_guard<std::mutex> lock(mutex);
+            chunks.push_back(chunk);
+        }
+
+        bool pop_back(TaskChunk& chunk) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (chunks.empty())
+                return false;
+
+            chunk = chunks.back();
+            chunks.pop_back();
+
+            return true;
+        }
+
+        bool steal_front(TaskChunk& chunk) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (chunks.empty())
+                return false;
+
+            chunk = chunks.front();
+            chunks.pop_front();
+
+            return true;
+        }
+};
+
+// Process-wide pool of persistent threads. A run deals the tasks round-robin
+// over the threads' deques; a thread then cuts guided chunks off whatever it
+// holds (remaining / (2 * threads), at least the grain) and leaves the rest
+// in its deque, where idle threads can steal it. Between runs the threads
+// sleep, so no thread is created or joined per multiplication.
+class WorkStealingScheduler {
+    private:
+        SchedulerOptions options;
+        unsigned int thread_count = 0;
+
+        std::vector<std::unique_ptr<SchedulerWorker>> workers;
+        std::vector<std::thread> threads;
+
+        std::mutex run_mutex;
+        std::mutex state_mutex;
+        std::condition_variable work_ready;
+        std::condition_variable run_done;
+        std::size_t generation = 0;
+        bool stopping = false;
+
+        std::atomic<std::size_t> remaining{0};
+
+        void _pin(unsigned int thread_index) {
+#ifdef __linux__
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(thread_index % std::max(1u, std::thread::hardware_concurrency()), &cpu_set);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#else
+            (void) thread_index;
+#endif
+        }
+
+        bool _steal(unsigned int thief_index, TaskChunk& chunk) {
+            for (unsigned int offset = 1; offset < thread_count; offset++)
+                if (workers[(thief_index + offset) % thread_count]->steal_front(chunk))
+                    return true;
+
+            return false;
+        }
+
+        void _drain(unsigned int thread_index) {
+            SchedulerWorker& worker = *workers[thread_index];
+
+            TaskChunk chunk;
+            while (remaining.load(std::memory_order_acquire) > 0) {
+                if (!worker.pop_back(chunk) && !_steal(thread_index, chunk)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                const std::size_t grain = options.grain_size ? options.grain_size : chunk.task->default_grain();
+                const std::size_t take = std::max(grain, chunk.count / (2 * thread_count));
+                if (chunk.count > take) {
+                    worker.push_back({ chunk.task, chunk.first + take, chunk.count - take });
+                    chunk.count = take;
+                }
+
+                chunk.task->execute_slice(chunk.first, chunk.count);
+
+                if (remaining.fetch_sub(chunk.count, std::memory_order_acq_rel) == chunk.count) {
+                    std::lock_guard<std::mutex> lock(state_mutex);
+                    run_done.notify_all();
+                }
+            }
+        }
+
+        void _thread_loop(unsigned int thread_index) {
+            if (options.pin_threads)
+                _pin(thread_index);
+
+            std::size_t seen_generation = 0;
+            for (;;) {
+                {
+                    std::unique_lock<std::mutex> lock(state_mutex);
+                    work_ready.wait(lock, [&]() { return stopping || generation != seen_generation; });
+
+                    if (stopping)
+                        return;
+
+                    seen_generation = generation;
+                }
+
+                _drain(thread_index);
+            }
+        }
+
+        void _start(const SchedulerOptions& new_options) {
+            options = new_options;
+            thread_count = options.thread_count ? options.thread_count : std::max(1u, std::thread::hardware_concurrency());
+
+            stopping = false;
+            for (unsigned int thread_index = 0; thread_index < thread_count; thread_index++)
+                workers.push_back(std::make_unique<SchedulerWorker>());
+
+            for (unsigned int thread_index = 0; thread_index < thread_count; thread_index++)
+                threads.emplace_back(&WorkStealingScheduler::_thread_loop, this, thread_index);
+        }
+
+        void _stop() {
+            {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                stopping = true;
+            }
+            work_ready.notify_all();
+
+            for (auto &thread : threads)
+                thread.join();
+
+            threads.clear();
+            workers.clear();
+        }
+
+        WorkStealingScheduler() {
+            _start(SchedulerOptions());
+        }
+
+    public:
+        WorkStealingScheduler(const WorkStealingScheduler&) = delete;
+        WorkStealingScheduler& operator=(const WorkStealingScheduler&) = delete;
+
+        ~WorkStealingScheduler() {
+            _stop();
+        }
+
+        static WorkStealingScheduler& instance() {
+            static WorkStealingScheduler scheduler;
+            return scheduler;
+        }
+
+        // Restarts the threads with new options; waits for a run in flight.
+        void configure(const SchedulerOptions& new_options) {
+            std::lock_guard<std::mutex> run_lock(run_mutex);
+
+            _stop();
+            _start(new_options);
+        }
+
+        unsigned int get_thread_count() const {
+            return thread_count;
+        }
+
+        // Blocks until every task has run. Concurrent callers take turns.
+        template <typename TaskType>
+        void run(const std::vector<TaskType>& tasks) {
+            std::lock_guard<std::mutex> run_lock(run_mutex);
+
+            std::size_t total = 0;
+            for (const RangeTask& task : tasks)
+                total += task.size();
+
+            if (total == 0)
+                return;
+
+            remaining.store(total, std::memory_order_release);
+            for (std::size_t task_index = 0; task_index < tasks.size(); task_index++)
+                if (tasks[task_index].size())
+                    workers[task_index % thread_count]->push_back({ &tasks[task_index], 0, tasks[task_index].size() });
+
+            {
+                std::lock_guard<std::mutex> lock(state_mutex);
+                generation++;
+            }
+            work_ready.notify_all();
+
+            std::unique_lock<std::mutex> lock(state_mutex);
+            run_done.wait(lock, [this]() { return remaining.load(std::memory_order_acquire) == 0; });
+        }
+};
+
+template <typename T, typename Acc = DefaultAccumulator<T>>
+Matrix<Acc> multiply_matrix_scheduler(const Matrix<T>& A, const Matrix<T>& B, TaskGenerator<T, Acc> task_generator) {
+    Matrix<Acc> result(B.width, A.height, 0);
+
+    const auto tasks = task_generator(A, B, result);
+    WorkStealingScheduler::instance().run(tasks);
+
+    return result;
 }
 
-double time_multiply_ms(MatrixMultiply multiply, const Matrix& A, const Matrix& B, TaskGenerator task_generator) {
+// The output tiles of a lazy expression (matrix_expression.h), one index per
+// tile.
+class ExpressionTileTask : public RangeTask {
+    std::size_t count;
+    const std::function<void(std::size_t)>& compute_tile;
+
+    public:
+        ExpressionTileTask(std::size_t count, const std::function<void(std::size_t)>& compute_tile) :
+            count(count), compute_tile(compute_tile) {}
+
+        std::size_t size() const override {
+            return count;
+        }
+
+        std::size_t default_grain() const override {
+            return 1;
+        }
+
+        void execute_slice(std::size_t first, std::size_t count) const override {
+            for (std::size_t tile_index = first; tile_index < first + count; tile_index++)
+                compute_tile(tile_index);
+        }
+};
+
+// Installed as the expression tile executor by main().
+void run_expression_tiles(std::size_t count, const std::function<void(std::size_t)>& compute_tile) {
+    const std::vector<ExpressionTileTask> tasks = { ExpressionTileTask(count, compute_tile) };
+    WorkStealingScheduler::instance().run(tasks);
+}
+
+// Rows [begin, end) of C = A * B for a CSR A and a dense B. Each nonzero
+// A(r, k) adds A(r, k) times row k of B to row r of C, so the work follows the
+// nonzeros of A and every inner loop is unit-stride.
+class SpmmTask : public RangeTask {
+    const SparseMatrix& A;
+    const Matrix<int32_t>& B;
+
+    Matrix<int32_t>& result;
+
+    std::size_t begin;
+    std::size_t end;
+
+    public:
+        SpmmTask(const SparseMatrix& A, const Matrix<int32_t>& B, Matrix<int32_t>& result, std::size_t begin, std::size_t end) :
+            A(A), B(B), result(result), begin(begin), end(end) {}
+
+        std::size_t size() const override {
+            return end - begin;
+        }
+
+        std::size_t default_grain() const override {
+            return SPARSE_ROW_GRAIN;
+        }
+
+        void execute_slice(std::size_t first, std::size_t count) const override {
+            static const AxpyKernel axpy = select_axpy_kernel();
+
+            for (std::size_t row_index = begin + first; row_index < std::min(end, begin + first + count); row_index++) {
+                int32_t* c = result.row(row_index);
+
+                for (std::size_t position = A.begin(row_index); position < A.end(row_index); position++)
+                    axpy(A.value(position), B.row(A.index(position)), c, B.width);
+            }
+        }
+};
+
+// Dense scratch row for Gustavson's SpGEMM, kept per thread and reused across
+// rows: a column is in the current row when its stamp matches.
+struct SparseAccumulator {
+    std::vector<int32_t> values;
+    std::vector<std::size_t> stamps;
+    std::vector<uint32_t> touched;
+    std::size_t current_stamp = 0;
+
+    void start_row(std::size_t width) {
+        if (values.size() < width) {
+            values.resize(width);
+            stamps.resize(width, 0);
+        }
+
+        current_stamp++;
+        touched.clear();
+    }
+
+    // Symbolic phase: only records that the column is in the row.
+    void mark(uint32_t col_index) {
+        if (stamps[col_index] != current_stamp) {
+            stamps[col_index] = current_stamp;
+            touched.push_back(col_index);
+        }
+    }
+
+    void add(uint32_t col_index, int32_t value) {
+        if (stamps[col_index] != current_stamp) {
+            stamps[col_index] = current_stamp;
+            values[col_index] = value;
+            touched.push_back(col_index);
+        } else
+            values[col_index] = wrapping_add(values[col_index], value);
+    }
+};
+
+enum class SpgemmPhase { SYMBOLIC, NUMERIC };
+
+// Rows [begin, end) of C = A * B for CSR A and B, row by row (Gustavson):
+// row r of C merges the rows of B picked by the nonzeros of row r of A. The
+// symbolic phase only marks each row's column pattern, with no multiplies
+// or value writes, and counts its nonzeros into offsets[r + 1]; once those
+// are prefix-summed the numeric phase writes every row into its slot, so C
+// is allocated exactly once at its final size.
+class SpgemmTask : public RangeTask {
+    const SparseMatrix& A;
+    const SparseMatrix& B;
+
+    SpgemmPhase phase;
+    std::vector<std::size_t>& offsets;
+    std::vector<uint32_t>& indices;
+    std::vector<int32_t>& values;
+
+    std::size_t begin;
+    std::size_t end;
+
+    public:
+        SpgemmTask(const SparseMatrix& A, const SparseMatrix& B, SpgemmPhase phase, std::vector<std::size_t>& offsets,
+                   std::vector<uint32_t>& indices, std::vector<int32_t>& values, std::size_t begin, std::size_t end) :
+            A(A), B(B), phase(phase), offsets(offsets), indices(indices), values(values), begin(begin), end(end) {}
+
+        std::size_t size() const override {
+            return end - begin;
+        }
+
+        std::size_t default_grain() const override {
+            return SPARSE_ROW_GRAIN;
+        }
+
+        void execute_slice(std::size_t first, std::size_t count) const override {
+            thread_local SparseAccumulator accumulator;
+
+            for (std::size_t row_index = begin + first; row_index < std::min(end, begin + first + count); row_index++) {
+                accumulator.start_row(B.width);
+
+                if (phase == SpgemmPhase::SYMBOLIC) {
+                    for (std::size_t a_position = A.begin(row_index); a_position < A.end(row_index); a_position++) {
+                        const uint32_t k = A.index(a_position);
+
+                        for (std::size_t b_position = B.begin(k); b_position < B.end(k); b_position++)
+                            accumulator.mark(B.index(b_position));
+                    }
+
+                    offsets[row_index + 1] = accumulator.touched.size();
+                    continue;
+                }
+
+                for (std::size_t a_position = A.begin(row_index); a_position < A.end(row_index); a_position++) {
+                    const int32_t a = A.value(a_position);
+                    const uint32_t k = A.index(a_position);
+
+                    for (std::size_t b_position = B.begin(k); b_position < B.end(k); b_position++)
+                        accumulator.add(B.index(b_position), wrapping_mul(a, B.value(b_position)));
+                }
+
+                std::sort(accumulator.touched.begin(), accumulator.touched.end());
+
+                std::size_t position = offsets[row_index];
+                for (const uint32_t col_index : accumulator.touched) {
+                    indices[position] = col_index;
+                    values[position++] = accumulator.values[col_index];
+                }
+            }
+        }
+};
+
+// Splits rows [0, row_count) into TASK_COUNT contiguous ranges; the
+// scheduler's stealing evens out rows with very different nonzero counts.
+template <typename Make>
+void split_rows(std::size_t row_count, Make make) {
+    std::size_t begin = 0;
+    for (std::size_t task_index = 0; task_index < TASK_COUNT; task_index++) {
+        const std::size_t end = begin + row_count / TASK_COUNT + (task_index < row_count % TASK_COUNT ? 1 : 0);
+
+        make(begin, end);
+        begin = end;
+    }
+}
+
+// Sparse times dense on the scheduler; a CSC operand is converted first.
+Matrix<int32_t> multiply_sparse_dense(const SparseMatrix& A, const Matrix<int32_t>& B) {
+    assert(A.width == B.height);
+
+    if (A.layout != SparseLayout::CSR)
+        return multiply_sparse_dense(A.to_layout(SparseLayout::CSR), B);
+
+    Matrix<int32_t> result(B.width, A.height, 0);
+
+    std::vector<SpmmTask> tasks;
+    split_rows(A.height, [&](std::size_t begin, std::size_t end) { tasks.emplace_back(A, B, result, begin, end); });
+    WorkStealingScheduler::instance().run(tasks);
+
+    return result;
+}
+
+// Sparse times sparse on the scheduler; the result is CSR and its memory is
+// proportional to its nonzeros.
+SparseMatrix multiply_sparse_sparse(const SparseMatrix& A, const SparseMatrix& B) {
+    assert(A.width == B.height);
+
+    if (A.layout != SparseLayout::CSR)
+        return multiply_sparse_sparse(A.to_layout(SparseLayout::CSR), B);
+    if (B.layout != SparseLayout::CSR)
+        return multiply_sparse_sparse(A, B.to_layout(SparseLayout::CSR));
+
+    std::vector<std::size_t> offsets(A.height + 1, 0);
+    std::vector<uint32_t> indices;
+    std::vector<int32_t> values;
+
+    for (const SpgemmPhase phase : { SpgemmPhase::SYMBOLIC, SpgemmPhase::NUMERIC }) {
+        if (phase == SpgemmPhase::NUMERIC) {
+            for (std::size_t row_index = 0; row_index < A.height; row_index++)
+                offsets[row_index + 1] += offsets[row_index];
+
+            indices.resize(offsets.back());
+            values.resize(offsets.back());
+        }
+
+        std::vector<SpgemmTask> tasks;
+        split_rows(A.height, [&](std::size_t begin, std::size_t end) {
+            tasks.emplace_back(A, B, phase, offsets, indices, values, begin, end);
+        });
+        WorkStealingScheduler::instance().run(tasks);
+    }
+
+    return SparseMatrix(B.width, A.height, SparseLayout::CSR, std::move(offsets), std::move(indices), std::move(values));
+}
+
+// C tile (tile_row, tile_col) += A tile (tile_row, k) * B tile (k, tile_col),
+// split into bands of GEMM_MC rows. The tiles are read and written in place
+// in the mapped files; edge tiles are zero-padded, so every tile is full size.
+class OutOfCoreTileTask : public RangeTask {
+    const MappedMatrixFile& A;
+    const MappedMatrixFile& B;
+
+    MappedMatrixFile& result;
+
+    std::size_t tile_row;
+    std::size_t tile_col;
+    std::size_t k;
+
+    public:
+        OutOfCoreTileTask(const MappedMatrixFile& A, const MappedMatrixFile& B, MappedMatrixFile& result,
+                          std::size_t tile_row, std::size_t tile_col, std::size_t k) :
+            A(A), B(B), result(result), tile_row(tile_row), tile_col(tile_col), k(k) {}
+
+        std::size_t size() const override {
+            return (result.tile_rows() + GEMM_MC - 1) / GEMM_MC;
+        }
+
+        std::size_t default_grain() const override {
+            return 1;
+        }
+
+        void execute_slice(std::size_t first, std::size_t count) const override {
+            const std::size_t row_begin = first * GEMM_MC;
+            const std::size_t row_end = std::min(result.tile_rows(), (first + count) * GEMM_MC);
+
+            const ConstMatrixView<int32_t> a_tile = { A.tile<int32_t>(tile_row, k), A.tile_cols() };
+            const ConstMatrixView<int32_t> b_tile = { B.tile<int32_t>(k, tile_col), B.tile_cols() };
+            const MatrixView<int32_t> c_tile = { result.tile<int32_t>(tile_row, tile_col), result.tile_cols() };
+
+            gemm_blocked(row_end - row_begin, result.tile_cols(), A.tile_cols(),
+                    a_tile.block(row_begin, 0), b_tile, c_tile.block(row_begin, 0));
+        }
+};
+
+// C = A * B on tiled matrix files (see matrix_file.h), for operands larger
+// than memory. C tiles are produced one at a time, each summed over the k
+// tiles on the scheduler, so at most one tile of A, B and C is being
+// computed on. A prefetch thread reads the next step's tiles in while the
+// current step runs, and every tile is released from the mapping once it is
+// done with, so resident memory stays at a few tiles whatever the matrix
+// size. A tile must be at least GEMM_MC rows tall to keep every thread busy.
+void multiply_matrix_file(const std::string& a_path, const std::string& b_path, const std::string& result_path) {
+    const MappedMatrixFile A = MappedMatrixFile::open(a_path);
+    const MappedMatrixFile B = MappedMatrixFile::open(b_path);
+
+    if (A.element_type() != ElementType::INT32 || B.element_type() != ElementType::INT32)
+        throw std::runtime_error("Out-of-core multiplication needs int32 matrix files");
+    if (A.cols() != B.rows())
+        throw std::runtime_error("Cannot multiply " + a_path + " by " + b_path + ": inner dimensions differ");
+    if (A.tile_cols() != B.tile_rows())
+        throw std::runtime_error("Cannot multiply " + a_path + " by " + b_path + ": inner tile sizes differ");
+
+    MappedMatrixFile result = MappedMatrixFile::create(result_path, ElementType::INT32, A.rows(), B.cols(),
+            A.tile_rows(), B.tile_cols());
+
+    const std::size_t grid_rows = result.tile_grid_rows();
+    const std::size_t grid_cols = result.tile_grid_cols();
+    const std::size_t grid_depth = A.tile_grid_cols();
+
+    A.prefetch_tile(0, 0);
+    B.prefetch_tile(0, 0);
+
+    // Steps run in (tile_row, tile_col, k) order. While the scheduler works
+    // on one, a prefetch thread faults in the A and B tiles of the next.
+    for (std::size_t tile_row = 0; tile_row < grid_rows; tile_row++) {
+        for (std::size_t tile_col = 0; tile_col < grid_cols; tile_col++) {
+            for (std::size_t k = 0; k < grid_depth; k++) {
+                const bool last_k = k + 1 == grid_depth;
+                std::size_t next_row = tile_row, next_col = tile_col, next_k = k + 1;
+                if (last_k) {
+                    next_k = 0;
+                    if (++next_col == grid_cols) {
+                        next_col = 0;
+                        next_row++;
+                    }
+                }
+                const bool has_next = next_row < grid_rows;
+
+                std::thread prefetcher;
+                if (has_next) {
+                    A.prefetch_tile(next_row, next_k);
+                    B.prefetch_tile(next_k, next_col);
+                    prefetcher = std::thread([&A, &B, next_row, next_k, next_col] {
+                        A.touch_tile(next_row, next_k);
+                        B.touch_tile(next_k, next_col);
+                    });
+                }
+
+                std::vector<OutOfCoreTileTask> tasks;
+                tasks.emplace_back(A, B, result, tile_row, tile_col, k);
+                WorkStealingScheduler::instance().run(tasks);
+
+                if (prefetcher.joinable())
+                    prefetcher.join();
+
+                // Keep a tile the next step reads again (a single k column
+                // of A, or a single tile column of B).
+                if (!has_next || next_row != tile_row || next_k != k)
+                    A.release_tile(tile_row, k);
+                if (!has_next || next_k != k || next_col != tile_col)
+                    B.release_tile(k, tile_col);
+                if (last_k)
+                    result.release_tile(tile_row, tile_col);
+            }
+        }
+    }
+
+    result.flush();
+}
+
+// Takes the executor and generator as plain callables so call sites can pass
+// e.g. multiply_matrix_seq<int8_t> without spelling out std::function.
+template <typename Multiply, typename T, typename Generator>
+double time_multiply_ms(Multiply multiply, const Matrix<T>& A, const Matrix<T>& B, Generator task_generator) {
     const auto t_start = std::chrono::high_resolution_clock::now();
-    Matrix result = multiply(A, B, task_generator);
+    const auto result = multiply(A, B, task_generator);
     const auto t_end = std::chrono::high_resolution_clock::now();
 
     return std::chrono::duration<double, std::milli>(t_end - t_start).count();
 }
 
-int main() {
-    Matrix A = Matrix(500, 500, 5);
-    Matrix B = Matrix(500, 500, 1);
+// Small integers in every element type, so floating-point products are
+// exact too and results compare bit for bit.
+template <typename T = int32_t>
+Matrix<T> random_matrix(std::size_t width, std::size_t height) {
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<int32_t> dist(-9, 9);
 
-    std::cout << "+++ MATRIX MULTIPLICATION +++" << std::endl << std::endl;
-    std::cout << "MATRIX A: " << A.width << "x" << A.height << std::endl;
-    std::cout << "MATRIX B: " << B.width << "x" << B.height << std::endl;
-    std::cout << std::endl;
-    std::cout << "TASK COUNT: " << TASK_COUNT << std::endl;
-    std::cout << "THREAD POOL SIZE: " << THREAD_POOL_SIZE << std::endl;
-    std::cout << std::endl;
+    Matrix<T> matrix(width, height);
+    for (std::size_t row_index = 0; row_index < height; row_index++)
+        for (std::size_t col_index = 0; col_index < width; col_index++)
+            matrix.set(row_index, col_index, static_cast<T>(dist(rng)));
 
-    std::cout << "=== ROW STRATEGY ===" << std::endl << std::endl;
-    std::cout << "SEQUENTIAL: \t\t" << time_multiply_ms(multiply_matrix_seq, A, B, multiply_matrix_row_tasks)
-        << "ms" << std::endl;
-    std::cout << "THREAD: \t\t" << time_multiply_ms(multiply_matrix_thread, A, B, multiply_matrix_row_tasks)
-        << "ms" << std::endl;
-    std::cout << "POOL: \t\t\t" << multiply_matrix_pool(A, B, multiply_matrix_row_tasks)
-        << "ms" << std::endl;
-    std::cout << std::endl;
+    return matrix;
+}
+
+// About density * width nonzeros per row, built straight into CSR.
+SparseMatrix random_sparse_matrix(std::size_t width, std::size_t height, double density) {
+    std::mt19937 rng(std::random_device{}());
+    std::binomial_distribution<std::size_t> count_dist(width, density);
+    std::uniform_int_distribution<uint32_t> col_dist(0, static_cast<uint32_t>(width - 1));
+    std::uniform_int_distribution<int32_t> value_dist(1, 9);
+
+    std::vector<std::size_t> offsets = { 0 };
+    std::vector<uint32_t> indices;
+    std::vector<int32_t> values;
+
+    for (std::size_t row_index = 0; row_index < height; row_index++) {
+        const std::size_t row_begin = indices.size();
+        for (std::size_t count = count_dist(rng); count > 0; count--)
+            indices.push_back(col_dist(rng));
+
+        std::sort(indices.begin() + row_begin, indices.end());
+        indices.erase(std::unique(indices.begin() + row_begin, indices.end()), indices.end());
+        for (std::size_t position = row_begin; position < indices.size(); position++)
+            values.push_back(value_dist(rng) * (rng() % 2 ? 1 : -1));
+
+        offsets.push_back(indices.size());
+    }
+
+    return SparseMatrix(width, height, SparseLayout::CSR, std::move(offsets), std::move(indices), std::move(values));
+}
+
+// Spot-checks the result against the reference dot product.
+template <typename T, typename Acc>
+void verify_samples(const Matrix<T>& A, const Matrix<T>& B, const Matrix<Acc>& result) {
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<std::size_t> row_dist(0, result.height - 1);
+    std::uniform_int_distribution<std::size_t> col_dist(0, result.width - 1);
+
+    for (std::size_t sample = 0; sample < GEMM_BENCH_SAMPLES; sample++) {
+        const std::size_t row_index = row_dist(rng);
+        const std::size_t col_index = col_dist(rng);
+
+        if (result.get(row_index, col_index) != compute_element<T, Acc>(row_index, col_index, A, B))
+            throw std::runtime_error("Wrong element at " + std::to_string(row_index) + ", " + std::to_string(col_index));
+    }
+}
+
+double gflops(std::size_t size, double elapsed_ms) {
+    return 2.0 * size * size * size / (elapsed_ms * 1e6);
+}
+
+void print_gemm_line(const std::string& name, std::size_t size, double elapsed_ms) {
+    std::cout << name << elapsed_ms << "ms\t" << gflops(size, elapsed_ms) << " GFLOP/s" << std::endl;
+}
+
+// Blocked GEMM against the naive row strategy on every executor. The naive
+// kernels are skipped above GEMM_BENCH_NAIVE_MAX_SIZE, where they take minutes.
+void run_gemm_benchmark(std::size_t strassen_cutoff) {
+    for (const std::size_t size : { 256, 512, 1024, 2048, 4096 }) {
+        const Matrix<int32_t> A = random_matrix(size, size);
+        const Matrix<int32_t> B = random_matrix(size, size);
+
+        std::cout << "=== GEMM " << size << "x" << size << " ===" << std::endl << std::endl;
+
+        if (size <= GEMM_BENCH_NAIVE_MAX_SIZE) {
+            print_gemm_line("NAIVE SEQUENTIAL: \t", size, 
+                    time_multiply_ms(multiply_matrix_seq<int32_t>, A, B, multiply_matrix_row_tasks<int32_t>));
+            print_gemm_line("NAIVE THREAD: \t\t", size, 
+                    time_multiply_ms(multiply_matrix_thread<int32_t>, A, B, multiply_matrix_row_tasks<int32_t>));
+            print_gemm_line("NAIVE POOL: \t\t", size, time_multiply_ms(multiply_matrix_pool<int32_t>, A, B, multiply_matrix_row_tasks<int32_t>));
+            print_gemm_line("NAIVE SCHEDULER: \t", size, 
+                    time_multiply_ms(multiply_matrix_scheduler<int32_t>, A, B, multiply_matrix_row_tasks<int32_t>));
+        }
+
+        const auto t_start = std::chrono::high_resolution_clock::now();
+        const Matrix<int32_t> result = multiply_matrix_seq<int32_t, int32_t>(A, B, multiply_matrix_blocked_tasks);
+        const auto t_end = std::chrono::high_resolution_clock::now();
+        verify_samples(A, B, result);
+
+        print_gemm_line("BLOCKED SEQUENTIAL: \t", size, std::chrono::duration<double, std::milli>(t_end - t_start).count());
+        print_gemm_line("BLOCKED THREAD: \t", size, 
+                time_multiply_ms(multiply_matrix_thread<int32_t, int32_t>, A, B, multiply_matrix_blocked_tasks));
+        print_gemm_line("BLOCKED POOL: \t\t", size, time_multiply_ms(multiply_matrix_pool<int32_t, int32_t>, A, B, multiply_matrix_blocked_tasks));
+        print_gemm_line("BLOCKED SCHEDULER: \t", size, 
+                time_multiply_ms(multiply_matrix_scheduler<int32_t, int32_t>, A, B, multiply_matrix_blocked_tasks));
+
+        if (size > strassen_cutoff) {
+            const auto t_strassen_start = std::chrono::high_resolution_clock::now();
+            const Matrix<int32_t> strassen_result = multiply_matrix_strassen(A, B, strassen_cutoff);
+            const auto t_strassen_end = std::chrono::high_resolution_clock::now();
+            verify_samples(A, B, strassen_result);
+
+            // Effective rate: the classical 2n^3 operations over the Strassen time.
+            print_gemm_line("STRASSEN: \t\t", size, 
+                    std::chrono::duration<double, std::milli>(t_strassen_end - t_strassen_start).count());
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Times the Strassen mode on a size x size product for each candidate cutoff
+// and returns the fastest one.
+std::size_t tune_strassen_cutoff(std::size_t size) {
+    const Matrix<int32_t> A = random_matrix(size, size);
+    const Matrix<int32_t> B = random_matrix(size, size);
+
+    std::size_t best_cutoff = DEFAULT_STRASSEN_CUTOFF;
+    double best_ms = 0;
+
+    std::cout << "=== STRASSEN CUTOFF " << size << "x" << size << " ===" << std::endl << std::endl;
+    for (const std::size_t cutoff : { 64, 128, 256, 512, 1024 }) {
+        const auto t_start = std::chrono::high_resolution_clock::now();
+        const Matrix<int32_t> result = multiply_matrix_strassen(A, B, cutoff);
+        const auto t_end = std::chrono::high_resolution_clock::now();
+        verify_samples(A, B, result);
+
+        const double elapsed_ms = std::chrono::duration<double, std::milli>(t_end - t_start).count();
+        std::cout << "CUTOFF " << cutoff << ": \t\t" << elapsed_ms << "ms" << std::endl;
+
+        if (best_ms == 0 || elapsed_ms < best_ms) {
+            best_ms = elapsed_ms;
+            best_cutoff = cutoff;
+        }
+    }
+    std::cout << "SELECTED CUTOFF: \t" << best_cutoff << std::endl << std::endl;
+
+    return best_cutoff;
+}
+
+// Blocked GEMM on the scheduler with 1, 2, 4, ... threads up to the core
+// count; the scheduler is restarted for each count outside the timing.
+void run_scaling_benchmark(SchedulerOptions options) {
+    const unsigned int core_count = std::max(1u, std::thread::hardware_concurrency());
+    const Matrix<int32_t> A = random_matrix(SCALING_BENCH_SIZE, SCALING_BENCH_SIZE);
+    const Matrix<int32_t> B = random_matrix(SCALING_BENCH_SIZE, SCALING_BENCH_SIZE);
+
+    std::cout << "=== SCHEDULER SCALING " << SCALING_BENCH_SIZE << "x" << SCALING_BENCH_SIZE 
+        << " (" << core_count << " cores) ===" << std::endl << std::endl;
+
+    double single_thread_ms = 0;
+    for (unsigned int thread_count = 1; ; thread_count = std::min(thread_count * 2, core_count)) {
+        options.thread_count = thread_count;
+        WorkStealingScheduler::instance().configure(options);
+
+        const double elapsed_ms = time_multiply_ms(multiply_matrix_scheduler<int32_t, int32_t>, A, B, multiply_matrix_blocked_tasks);
+        if (thread_count == 1)
+            single_thread_ms = elapsed_ms;
+
+        std::cout << thread_count << " THREADS: \t\t" << elapsed_ms << "ms\t" 
+            << gflops(SCALING_BENCH_SIZE, elapsed_ms) << " GFLOP/s\t" 
+            << single_thread_ms / elapsed_ms << "x" << std::endl;
+
+        if (thread_count == core_count)
+            break;
+    }
 
-    std::cout << "=== ROW STRATEGY ===" << std::endl << std::endl;
-    std::cout << "SEQUENTIAL: \t\t" << time_multiply_ms(multiply_matrix_seq, A, B, multiply_matrix_row_tasks)
-        << "ms" << std::endl;
-    std::cout << "THREAD: \t\t" << time_multiply_ms(multiply_matrix_thread, A, B, multiply_matrix_row_tasks)
-        << "ms" << std::endl;
-    std::cout << "POOL: \t\t\t" << multiply_matrix_pool(A, B, multiply_matrix_row_tasks)
-        << "ms" << std::endl;
     std::cout << std::endl;
+}
+
+double elapsed_ms_since(std::chrono::high_resolution_clock::time_point t_start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - t_start).count();
+}
+
+// Sparse kernels against the dense blocked kernel at a few densities; the
+// dense baseline multiplies the same operands with their zeros filled in.
+void run_sparse_benchmark() {
+    const Matrix<int32_t> B = random_matrix(SPARSE_BENCH_SIZE, SPARSE_BENCH_SIZE);
+
+    for (const double density : { 0.001, 0.01, 0.05 }) {
+        const SparseMatrix sparse_a = random_sparse_matrix(SPARSE_BENCH_SIZE, SPARSE_BENCH_SIZE, density);
+        const SparseMatrix sparse_b = random_sparse_matrix(SPARSE_BENCH_SIZE, SPARSE_BENCH_SIZE, density);
+        const Matrix<int32_t> dense_a = sparse_a.to_dense();
+        const Matrix<int32_t> dense_b = sparse_b.to_dense();
+
+        std::cout << "=== SPARSE " << SPARSE_BENCH_SIZE << "x" << SPARSE_BENCH_SIZE << ", " << density * 100 
+            << "% NONZERO ===" << std::endl << std::endl;
+        std::cout << "A: 			" << sparse_a.nonzero_count() << " nonzeros, " << sparse_a.memory_bytes() / 1e6 
+            << "MB (dense " << SPARSE_BENCH_SIZE * SPARSE_BENCH_SIZE * sizeof(int32_t) / 1e6 << "MB)" << std::endl;
+
+        auto t_start = std::chrono::high_resolution_clock::now();
+        const Matrix<int32_t> dense_result = multiply_matrix_scheduler<int32_t, int32_t>(dense_a, B, multiply_matrix_blocked_tasks);
+        std::cout << "DENSE BLOCKED: 		" << elapsed_ms_since(t_start) << "ms" << std::endl;
+
+        t_start = std::chrono::high_resolution_clock::now();
+        const Matrix<int32_t> spmm_result = multiply_sparse_dense(sparse_a, B);
+        std::cout << "SPMM: 			" << elapsed_ms_since(t_start) << "ms" << std::endl;
+        verify_samples(dense_a, B, spmm_result);
+
+        t_start = std::chrono::high_resolution_clock::now();
+        const SparseMatrix spgemm_result = multiply_sparse_sparse(sparse_a, sparse_b);
+        std::cout << "SPGEMM: 		" << elapsed_ms_since(t_start) << "ms	" << spgemm_result.nonzero_count() 
+            << " nonzeros, " << spgemm_result.memory_bytes() / 1e6 << "MB" << std::endl;
+        verify_samples(dense_a, dense_b, spgemm_result.to_dense());
+
+        std::cout << std::endl;
+    }
+}
+
+// Random int32 matrix file written tile by tile, so it never has to fit in
+// memory.
+void random_matrix_file(const std::string& path, std::size_t rows, std::size_t cols, std::size_t tile_size) {
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<int32_t> dist(-9, 9);
+
+    MappedMatrixFile file = MappedMatrixFile::create(path, ElementType::INT32, rows, cols, tile_size, tile_size);
+    for (std::size_t tile_row = 0; tile_row < file.tile_grid_rows(); tile_row++)
+        for (std::size_t tile_col = 0; tile_col < file.tile_grid_cols(); tile_col++) {
+            int32_t* block = file.tile<int32_t>(tile_row, tile_col);
+            const std::size_t valid_rows = std::min(tile_size, rows - tile_row * tile_size);
+            const std::size_t valid_cols = std::min(tile_size, cols - tile_col * tile_size);
+
+            for (std::size_t row = 0; row < valid_rows; row++)
+                for (std::size_t col = 0; col < valid_cols; col++)
+                    block[row * tile_size + col] = dist(rng);
+
+            file.release_tile(tile_row, tile_col);
+        }
+
+    file.flush();
+}
+
+std::size_t peak_resident_mb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return static_cast<std::size_t>(usage.ru_maxrss) / 1024;
+}
+
+// Writes two size x size operands to the temporary directory, multiplies them
+// through the files and spot-checks the result against the operand files.
+void run_out_of_core_benchmark(std::size_t size, std::size_t tile_size) {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string a_path = directory / "matrix_a.tiles";
+    const std::string b_path = directory / "matrix_b.tiles";
+    const std::string result_path = directory / "matrix_c.tiles";
+
+    std::cout << "=== OUT OF CORE " << size << "x" << size << ", " << tile_size << "x" << tile_size
+        << " TILES ===" << std::endl << std::endl;
+    std::cout << "OPERANDS: \t\t" << 2.0 * size * size * sizeof(int32_t) / 1e6 << "MB in " << directory << std::endl;
+
+    auto t_start = std::chrono::high_resolution_clock::now();
+    random_matrix_file(a_path, size, size, tile_size);
+    random_matrix_file(b_path, size, size, tile_size);
+    std::cout << "WRITE: \t\t\t" << elapsed_ms_since(t_start) << "ms" << std::endl;
+
+    t_start = std::chrono::high_resolution_clock::now();
+    multiply_matrix_file(a_path, b_path, result_path);
+    const double elapsed_ms = elapsed_ms_since(t_start);
+    print_gemm_line("MULTIPLY: \t\t", size, elapsed_ms);
+    std::cout << "PEAK RESIDENT: \t\t" << peak_resident_mb() << "MB" << std::endl;
+
+    const MappedMatrixFile A = MappedMatrixFile::open(a_path);
+    const MappedMatrixFile B = MappedMatrixFile::open(b_path);
+    const MappedMatrixFile result = MappedMatrixFile::open(result_path);
+
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<std::size_t> index_dist(0, size - 1);
+    for (std::size_t sample = 0; sample < GEMM_BENCH_SAMPLES; sample++) {
+        const std::size_t row_index = index_dist(rng);
+        const std::size_t col_index = index_dist(rng);
+
+        int32_t expected = 0;
+        for (std::size_t k = 0; k < size; k++)
+            expected += A.get<int32_t>(row_index, k) * B.get<int32_t>(k, col_index);
+
+        if (result.get<int32_t>(row_index, col_index) != expected)
+            throw std::runtime_error("Wrong element at " + std::to_string(row_index) + ", " + std::to_string(col_index));
+    }
+
+    for (const std::string& path : { a_path, b_path, result_path })
+        std::filesystem::remove(path);
 
-    std::cout << "=== COLUMN STRATEGY ===" << std::endl << std::endl;
-    std::cout << "SEQUENTIAL: \t\t" << time_multiply_ms(multiply_matrix_seq, A, B, multiply_matrix_col_tasks)
-        << "ms" << std::endl;
-    std::cout << "THREAD: \t\t" << time_multiply_ms(multiply_matrix_thread, A, B, multiply_matrix_col_tasks)
-        << "ms" << std::endl;
-    std::cout << "POOL: \t\t\t" << multiply_matrix_pool(A, B, multiply_matrix_col_tasks) 
-        << "ms" << std::endl;
     std::cout << std::endl;
+}
+
+// A is rows x depth, B is depth x cols.
+struct BenchShape {
+    std::size_t rows;
+    std::size_t depth;
+    std::size_t cols;
+};
+
+struct BenchOptions {
+    std::vector<BenchShape> shapes = { { DEFAULT_BENCH_SIZE, DEFAULT_BENCH_SIZE, DEFAULT_BENCH_SIZE } };
+    // Element types, optionally with an accumulator: int8, int16, int32,
+    // int32:int32, int32:int64, int64, float, float:double, double.
+    std::vector<std::string> types = { "int32", "int32:int32" };
+    std::vector<std::string> strategies = { "row", "col", "kth", "blocked" };
+    std::vector<std::string> executors = { "seq", "thread", "pool", "scheduler" };
+    // Scheduler thread counts to sweep; empty uses the --threads setting.
+    std::vector<unsigned int> thread_counts;
+    std::size_t trials = DEFAULT_BENCH_TRIALS;
+};
+
+std::vector<std::string> split_list(const std::string& list, char separator = ',') {
+    std::vector<std::string> items;
+
+    std::size_t item_begin = 0;
+    for (;;) {
+        const std::size_t item_end = list.find(separator, item_begin);
+        items.push_back(list.substr(item_begin, item_end - item_begin));
+
+        if (item_end == std::string::npos)
+            return items;
+
+        item_begin = item_end + 1;
+    }
+}
+
+// "N" for N x N times N x N, or "MxKxN".
+BenchShape parse_shape(const std::string& text) {
+    const std::vector<std::string> dimensions = split_list(text, 'x');
+
+    try {
+        if (dimensions.size() == 1) {
+            const std::size_t size = std::stoul(dimensions[0]);
+            if (size > 0)
+                return { size, size, size };
+        } else if (dimensions.size() == 3) {
+            const BenchShape shape = { std::stoul(dimensions[0]), std::stoul(dimensions[1]), std::stoul(dimensions[2]) };
+            if (shape.rows > 0 && shape.depth > 0 && shape.cols > 0)
+                return shape;
+        }
+    } catch (const std::logic_error&) {}
+
+    throw std::runtime_error("Bad shape: " + text);
+}
+
+template <typename T, typename Acc>
+struct ElementTypes {
+    typedef T Element;
+    typedef Acc Accumulator;
+};
+
+// Calls visit(ElementTypes<T, Acc>()) for the named element type.
+template <typename Visit>
+void visit_element_types(const std::string& name, Visit visit) {
+    if (name == "int8")
+        visit(ElementTypes<int8_t, int32_t>());
+    else if (name == "int16")
+        visit(ElementTypes<int16_t, int32_t>());
+    else if (name == "int32:int32")
+        visit(ElementTypes<int32_t, int32_t>());
+    else if (name == "int32" || name == "int32:int64")
+        visit(ElementTypes<int32_t, int64_t>());
+    else if (name == "int64")
+        visit(ElementTypes<int64_t, int64_t>());
+    else if (name == "float")
+        visit(ElementTypes<float, float>());
+    else if (name == "float:double")
+        visit(ElementTypes<float, double>());
+    else if (name == "double")
+        visit(ElementTypes<double, double>());
+    else
+        throw std::runtime_error("Unknown element type: " + name);
+}
+
+template <typename T, typename Acc>
+constexpr bool has_blocked_kernel() {
+    return std::is_same_v<T, int32_t> && std::is_same_v<Acc, int32_t>;
+}
+
+template <typename T, typename Acc = DefaultAccumulator<T>>
+TaskGenerator<T, Acc> task_generator_by_name(const std::string& name) {
+    if (name == "row")
+        return multiply_matrix_row_tasks<T, Acc>;
+    if (name == "col")
+        return multiply_matrix_col_tasks<T, Acc>;
+    if (name == "kth")
+        return multiply_matrix_kth_tasks<T, Acc>;
+    if (name == "blocked") {
+        if constexpr (has_blocked_kernel<T, Acc>())
+            return multiply_matrix_blocked_tasks;
+
+        throw std::runtime_error("The blocked strategy needs int32 elements and accumulator");
+    }
+
+    throw std::runtime_error("Unknown strategy: " + name);
+}
+
+template <typename T, typename Acc = DefaultAccumulator<T>>
+MatrixMultiply<T, Acc> executor_by_name(const std::string& name) {
+    if (name == "seq")
+        return multiply_matrix_seq<T, Acc>;
+    if (name == "thread")
+        return multiply_matrix_thread<T, Acc>;
+    if (name == "pool")
+        return multiply_matrix_pool<T, Acc>;
+    if (name == "scheduler")
+        return multiply_matrix_scheduler<T, Acc>;
+
+    throw std::runtime_error("Unknown executor: " + name);
+}
+
+unsigned int executor_thread_count(const std::string& name) {
+    if (name == "seq")
+        return 1;
+    if (name == "thread")
+        return TASK_COUNT;
+    if (name == "pool")
+        return THREAD_POOL_SIZE;
+
+    return WorkStealingScheduler::instance().get_thread_count();
+}
+
+template <typename T>
+bool same_elements(const Matrix<T>& lhs, const Matrix<T>& rhs) {
+    if (lhs.width != rhs.width || lhs.height != rhs.height)
+        return false;
+
+    for (std::size_t row_index = 0; row_index < lhs.height; row_index++)
+        if (!std::equal(lhs.row(row_index), lhs.row(row_index) + lhs.width, rhs.row(row_index)))
+            return false;
+
+    return true;
+}
+
+// Computed once per shape outside the task and executor machinery under
+// test (the blocked kernel for int32, a plain i-k-j loop otherwise) and
+// spot-checked against the dot product definition.
+template <typename T, typename Acc>
+Matrix<Acc> reference_product(const Matrix<T>& A, const Matrix<T>& B) {
+    Matrix<Acc> reference(B.width, A.height, 0);
+
+    if constexpr (has_blocked_kernel<T, Acc>())
+        gemm_blocked(A.height, B.width, A.width, A.view(), B.view(), reference.view());
+    else
+        for (std::size_t row_index = 0; row_index < A.height; row_index++) {
+            Acc* c = reference.row(row_index);
+
+            for (std::size_t k = 0; k < A.width; k++) {
+                const Acc a = static_cast<Acc>(A.get(row_index, k));
+                const T* b = B.row(k);
+
+                for (std::size_t col_index = 0; col_index < B.width; col_index++)
+                    c[col_index] += a * static_cast<Acc>(b[col_index]);
+            }
+        }
+
+    verify_samples(A, B, reference);
+
+    return reference;
+}
+
+// Every strategy x executor for every shape of one element type, with the
+// scheduler also swept over the thread counts. Each trial's result is
+// compared in full against the reference. Prints one CSV row per
+// configuration:
+//   - gops: 2 * rows * depth * cols operations over the median time
+//   - bandwidth_gbs: compulsory traffic (A and B read once, C written once)
+//     over the median time, a lower bound on what the kernel moved
+//   - speedup / efficiency: against the first single-threaded run of the
+//     same shape and strategy, and speedup per thread
+// Returns the number of configurations with a wrong result.
+template <typename T, typename Acc>
+std::size_t run_benchmark_suite_for(const std::string& type_name, const BenchOptions& options, 
+                                    SchedulerOptions scheduler_options) {
+    std::vector<unsigned int> thread_counts = options.thread_counts;
+    if (thread_counts.empty())
+        thread_counts.push_back(scheduler_options.thread_count);
+
+    std::size_t failure_count = 0;
+
+    for (const BenchShape& shape : options.shapes) {
+        const Matrix<T> A = random_matrix<T>(shape.depth, shape.rows);
+        const Matrix<T> B = random_matrix<T>(shape.cols, shape.depth);
+        const Matrix<Acc> reference = reference_product<T, Acc>(A, B);
+
+        const double operations = 2.0 * shape.rows * shape.depth * shape.cols;
+        const double bytes = sizeof(T) * (static_cast<double>(shape.rows) * shape.depth + shape.depth * shape.cols)
+            + sizeof(Acc) * static_cast<double>(shape.rows) * shape.cols;
+
+        std::map<std::string, double> single_thread_ms;
+
+        for (std::size_t count_index = 0; count_index < thread_counts.size(); count_index++) {
+            scheduler_options.thread_count = thread_counts[count_index];
+            WorkStealingScheduler::instance().configure(scheduler_options);
+
+            for (const std::string& strategy : options.strategies)
+                for (const std::string& executor : options.executors) {
+                    // Only the scheduler depends on the swept thread count, and
+                    // only int32 has a blocked kernel.
+                    if (executor != "scheduler" && count_index > 0)
+                        continue;
+                    if (strategy == "blocked" && !has_blocked_kernel<T, Acc>())
+                        continue;
+
+                    const TaskGenerator<T, Acc> task_generator = task_generator_by_name<T, Acc>(strategy);
+                    const MatrixMultiply<T, Acc> multiply = executor_by_name<T, Acc>(executor);
+                    const unsigned int thread_count = executor_thread_count(executor);
+
+                    std::vector<double> trial_ms;
+                    bool verified = true;
+                    for (std::size_t trial = 0; trial < options.trials; trial++) {
+                        const auto t_start = std::chrono::high_resolution_clock::now();
+                        const Matrix<Acc> result = multiply(A, B, task_generator);
+                        trial_ms.push_back(elapsed_ms_since(t_start));
+
+                        verified = verified && same_elements(result, reference);
+                    }
+
+                    std::sort(trial_ms.begin(), trial_ms.end());
+                    const double median_ms = trial_ms[trial_ms.size() / 2];
+
+                    if (thread_count == 1 && !single_thread_ms.count(strategy))
+                        single_thread_ms[strategy] = median_ms;
+
+                    std::cout << type_name << "," << shape.rows << "," << shape.depth << "," << shape.cols << "," << strategy << "," 
+                        << executor << "," << thread_count << "," << options.trials << "," << trial_ms.front() << "," 
+                        << median_ms << "," << operations / (median_ms * 1e6) << "," << bytes / (median_ms * 1e6) << ",";
+                    if (single_thread_ms.count(strategy)) {
+                        const double speedup = single_thread_ms[strategy] / median_ms;
+                        std::cout << speedup << "," << speedup / thread_count;
+                    } else
+                        std::cout << ",";
+                    std::cout << "," << (verified ? "yes" : "NO") << std::endl;
+
+                    if (!verified)
+                        failure_count++;
+                }
+        }
+    }
+
+    return failure_count;
+}
+
+std::size_t run_benchmark_suite(const BenchOptions& options, const SchedulerOptions& scheduler_options) {
+    std::cout << "type,rows,depth,cols,strategy,executor,threads,trials,min_ms,median_ms,gops,bandwidth_gbs,"
+        << "speedup,efficiency,verified" << std::endl;
+
+    std::size_t failure_count = 0;
+    for (const std::string& type_name : options.types)
+        visit_element_types(type_name, [&](auto types) {
+            typedef typename decltype(types)::Element T;
+            typedef typename decltype(types)::Accumulator Acc;
+
+            failure_count += run_benchmark_suite_for<T, Acc>(type_name, options, scheduler_options);
+        });
+
+    return failure_count;
+}
+
+// Multi-step pipelines computed eagerly, one full-size matrix per step, and
+// as one lazy expression, with both results compared in full.
+void run_expression_benchmark() {
+    const std::size_t size = EXPRESSION_BENCH_SIZE;
+    const Matrix<int32_t> A = random_matrix(size, size);
+    const Matrix<int32_t> B = random_matrix(size, size);
+    const Matrix<int32_t> C = random_matrix(size, size);
+    const Matrix<int32_t> v = random_matrix(1, size);
+
+    std::cout << "=== EXPRESSIONS " << size << "x" << size << " ===" << std::endl << std::endl;
+
+    const auto report = [](const std::string& name, double eager_ms, double fused_ms, bool verified) {
+        std::cout << name << "EAGER " << eager_ms << "ms\tFUSED " << fused_ms << "ms\t" 
+            << eager_ms / fused_ms << "x" << (verified ? "" : "\tWRONG RESULT") << std::endl;
+        if (!verified)
+            throw std::runtime_error("Fused expression differs from the eager pipeline");
+    };
+
+    // A * B + C: the eager pipeline writes A * B, then reads it back for the sum.
+    auto t_start = std::chrono::high_resolution_clock::now();
+    Matrix<int32_t> eager = multiply_matrix_scheduler<int32_t, int32_t>(A, B, multiply_matrix_blocked_tasks);
+    for (std::size_t row_index = 0; row_index < size; row_index++)
+        for (std::size_t col_index = 0; col_index < size; col_index++)
+            eager.row(row_index)[col_index] += C.get(row_index, col_index);
+    double eager_ms = elapsed_ms_since(t_start);
+
+    t_start = std::chrono::high_resolution_clock::now();
+    Matrix<int32_t> fused = A * B + C;
+    report("A * B + C: \t\t", eager_ms, elapsed_ms_since(t_start), same_elements(eager, fused));
+
+    // 2 * (A * B) - C^T.
+    t_start = std::chrono::high_resolution_clock::now();
+    const Matrix<int32_t> product = multiply_matrix_scheduler<int32_t, int32_t>(A, B, multiply_matrix_blocked_tasks);
+    Matrix<int32_t> eager_scaled(size, size);
+    for (std::size_t row_index = 0; row_index < size; row_index++)
+        for (std::size_t col_index = 0; col_index < size; col_index++)
+            eager_scaled.set(row_index, col_index, 2 * product.get(row_index, col_index) - C.get(col_index, row_index));
+    eager_ms = elapsed_ms_since(t_start);
+
+    t_start = std::chrono::high_resolution_clock::now();
+    Matrix<int32_t> fused_scaled = 2 * (A * B) - transpose(C);
+    report("2 * (A * B) - C^T: \t", eager_ms, elapsed_ms_since(t_start), same_elements(eager_scaled, fused_scaled));
+
+    // (A * B) * v: evaluated as A * (B * v), two matrix-vector products.
+    t_start = std::chrono::high_resolution_clock::now();
+    const Matrix<int32_t> eager_product = multiply_matrix_scheduler<int32_t, int32_t>(A, B, multiply_matrix_blocked_tasks);
+    const Matrix<int32_t> eager_vector = multiply_matrix_scheduler<int32_t, int32_t>(eager_product, v, multiply_matrix_row_tasks<int32_t, int32_t>);
+    eager_ms = elapsed_ms_since(t_start);
+
+    t_start = std::chrono::high_resolution_clock::now();
+    Matrix<int32_t> fused_vector = (A * B) * v;
+    report("(A * B) * v: \t\t", eager_ms, elapsed_ms_since(t_start), same_elements(eager_vector, fused_vector));
 
-    std::cout << "=== K-TH STRATEGY ===" << std::endl << std::endl;
-    std::cout << "SEQUENTIAL: \t\t" << time_multiply_ms(multiply_matrix_seq, A, B, multiply_matrix_kth_tasks)
-        << "ms" << std::endl;
-    std::cout << "THREAD: \t\t" << time_multiply_ms(multiply_matrix_thread, A, B, multiply_matrix_kth_tasks)
-        << "ms" << std::endl;
-    std::cout << "POOL: \t\t\t" << multiply_matrix_pool(A, B, multiply_matrix_kth_tasks)
-        << "ms" << std::endl;
     std::cout << std::endl;
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: " << program << " [options]" << std::endl
+        << "Without a mode flag, runs the benchmark suite and prints CSV:" << std::endl
+        << "  --shapes LIST    comma-separated N or MxKxN (A is MxK, B is KxN; default "
+        << DEFAULT_BENCH_SIZE << ")" << std::endl
+        << "  --types LIST     element[:accumulator] types of int8,int16,int32,int32:int32,int64," << std::endl
+        << "                   float,float:double,double (default: int32,int32:int32;"
+        << std::endl << "                   int32 sums in int64, int32:int32 wraps)" << std::endl
+        << "  --strategies LIST  of row,col,kth,blocked (default: all; blocked is int32:int32 only)" << std::endl
+        << "  --executors LIST of seq,thread,pool,scheduler (default: all)" << std::endl
+        << "  --thread-counts LIST  scheduler thread counts to sweep (default: --threads)" << std::endl
+        << "  --trials N       timed runs per configuration (default " << DEFAULT_BENCH_TRIALS << ")" << std::endl
+        << "Modes and scheduler settings:" << std::endl
+        << "  --gemm-bench     blocked GEMM against the naive kernels, 256 to 4096" << std::endl
+        << "  --scaling        scheduler speedup from 1 thread up to the core count" << std::endl
+        << "  --sparse         CSR SpMM and SpGEMM against the dense blocked kernel" << std::endl
+        << "  --expressions    eager multi-step pipelines against fused lazy expressions" << std::endl
+        << "  --out-of-core N  N x N product through tiled matrix files in the temporary directory" << std::endl
+        << "  --tile N         tile size of those files (default " << DEFAULT_OUT_OF_CORE_TILE << ")" << std::endl
+        << "  --threads N      scheduler threads (default: one per core)" << std::endl
+        << "  --grain N        smallest chunk of a task handed out (default: per strategy)" << std::endl
+        << "  --pin            pin scheduler threads to cores" << std::endl
+        << "  --strassen-cutoff N  largest block Strassen hands to the classical kernel (default: "
+        << DEFAULT_STRASSEN_CUTOFF << ")" << std::endl
+        << "  --strassen-tune  pick the Strassen cutoff by timing a " << STRASSEN_TUNE_SIZE << "x" 
+        << STRASSEN_TUNE_SIZE << " product" << std::endl;
+}
+
+int main(int argc, char** argv) {
+    SchedulerOptions scheduler_options;
+    bool gemm_bench = false;
+    bool scaling = false;
+    bool sparse = false;
+    bool expressions = false;
+    std::size_t out_of_core_size = 0;
+    std::size_t out_of_core_tile = DEFAULT_OUT_OF_CORE_TILE;
+    std::size_t strassen_cutoff = DEFAULT_STRASSEN_CUTOFF;
+    bool strassen_tune = false;
+    BenchOptions bench_options;
+
+    try {
+        for (int arg_index = 1; arg_index < argc; arg_index++) {
+            const std::string arg = argv[arg_index];
+            const bool has_value = arg_index + 1 < argc;
+
+            if (arg == "--gemm-bench")
+                gemm_bench = true;
+            else if (arg == "--scaling")
+                scaling = true;
+            else if (arg == "--sparse")
+                sparse = true;
+            else if (arg == "--expressions")
+                expressions = true;
+            else if (arg == "--out-of-core" && has_value)
+                out_of_core_size = std::stoul(argv[++arg_index]);
+            else if (arg == "--tile" && has_value)
+                out_of_core_tile = std::stoul(argv[++arg_index]);
+            else if (arg == "--threads" && has_value)
+                scheduler_options.thread_count = std::stoul(argv[++arg_index]);
+            else if (arg == "--grain" && has_value)
+                scheduler_options.grain_size = std::stoul(argv[++arg_index]);
+            else if (arg == "--pin")
+                scheduler_options.pin_threads = true;
+            else if (arg == "--strassen-cutoff" && has_value)
+                strassen_cutoff = std::stoul(argv[++arg_index]);
+            else if (arg == "--strassen-tune")
+                strassen_tune = true;
+            else if (arg == "--shapes" && has_value) {
+                bench_options.shapes.clear();
+                for (const std::string& shape : split_list(argv[++arg_index]))
+                    bench_options.shapes.push_back(parse_shape(shape));
+            }
+            else if (arg == "--types" && has_value) {
+                bench_options.types = split_list(argv[++arg_index]);
+                for (const std::string& type_name : bench_options.types)
+                    visit_element_types(type_name, [](auto) {});
+            }
+            else if (arg == "--strategies" && has_value) {
+                bench_options.strategies = split_list(argv[++arg_index]);
+                for (const std::string& strategy : bench_options.strategies)
+                    task_generator_by_name<int32_t, int32_t>(strategy);
+            }
+            else if (arg == "--executors" && has_value) {
+                bench_options.executors = split_list(argv[++arg_index]);
+                for (const std::string& executor : bench_options.executors)
+                    executor_by_name<int32_t, int32_t>(executor);
+            }
+            else if (arg == "--thread-counts" && has_value) {
+                bench_options.thread_counts.clear();
+                for (const std::string& thread_count : split_list(argv[++arg_index]))
+                    bench_options.thread_counts.push_back(std::max(1ul, std::stoul(thread_count)));
+            }
+            else if (arg == "--trials" && has_value)
+                bench_options.trials = std::max(1ul, std::stoul(argv[++arg_index]));
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        if (scaling) {
+            run_scaling_benchmark(scheduler_options);
+            return 0;
+        }
+
+        WorkStealingScheduler::instance().configure(scheduler_options);
+        expression_tile_executor() = run_expression_tiles;
+
+        if (strassen_cutoff == 0)
+            throw std::runtime_error("Strassen cutoff must be positive");
+        if (strassen_tune)
+            strassen_cutoff = tune_strassen_cutoff(STRASSEN_TUNE_SIZE);
+
+        if (gemm_bench) {
+            run_gemm_benchmark(strassen_cutoff);
+            return 0;
+        }
+
+        if (sparse) {
+            run_sparse_benchmark();
+            return 0;
+        }
 
+        if (expressions) {
+            run_expression_benchmark();
+            return 0;
+        }
+
+        if (out_of_core_size) {
+            if (out_of_core_tile == 0)
+                throw std::runtime_error("Tile size must be positive");
+
+            run_out_of_core_benchmark(out_of_core_size, out_of_core_tile);
+            return 0;
+        }
 
-    return 0;
+        return run_benchmark_suite(bench_options, scheduler_options) ? 1 : 0;
+    } catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
 }
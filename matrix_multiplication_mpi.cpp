@@ -0,0 +1,399 @@
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+
+#include <mpi.h>
+
+#include "matrix.h"
+
+// SUMMA over a 2D process grid: C (rows x cols) = A (rows x depth) * B (depth x cols).
+//
+//   mpicxx -std=c++17 -O2 matrix_multiplication_mpi.cpp -o matrix_multiplication_mpi
+//   mpirun -np 4 ./matrix_multiplication_mpi --size 2048
+
+static constexpr std::size_t DEFAULT_MATRIX_SIZE = 2048;
+static constexpr std::size_t DEFAULT_PANEL_WIDTH = 256;
+static constexpr std::size_t VERIFY_SAMPLES = 64;
+
+namespace summa {
+    const int CHIEF_RANK = 0;
+}
+
+struct SummaOptions {
+    std::size_t rows = DEFAULT_MATRIX_SIZE;
+    std::size_t depth = DEFAULT_MATRIX_SIZE;
+    std::size_t cols = DEFAULT_MATRIX_SIZE;
+    // Depth of the A column panel and B row panel broadcast per step; panels
+    // are also cut wherever the owning grid column or row changes.
+    std::size_t panel_width = DEFAULT_PANEL_WIDTH;
+};
+
+struct SummaStats {
+    double elapsed_s = 0;
+    // Time spent blocked on broadcasts the local kernel could not hide.
+    double wait_s = 0;
+    std::uint64_t bytes_received = 0;
+    std::uint64_t mismatch_count = 0;
+};
+
+// Entries are a function of their global position, so every rank builds its
+// own blocks without a scatter and can check any element of C on its own.
+int32_t a_element(std::size_t row_index, std::size_t k) {
+    return static_cast<int32_t>((row_index * 7 + k * 13) % 19) - 9;
+}
+
+int32_t b_element(std::size_t k, std::size_t col_index) {
+    return static_cast<int32_t>((k * 11 + col_index * 5) % 17) - 8;
+}
+
+// First index of part part_index when total indices are split into parts
+// near-equal ranges.
+std::size_t block_begin(std::size_t part_index, std::size_t total, std::size_t parts) {
+    return part_index * total / parts;
+}
+
+std::size_t block_owner(std::size_t index, std::size_t total, std::size_t parts) {
+    std::size_t owner = index * parts / std::max<std::size_t>(total, 1);
+    while (owner + 1 < parts && block_begin(owner + 1, total, parts) <= index)
+        owner++;
+    while (owner > 0 && block_begin(owner, total, parts) > index)
+        owner--;
+
+    return owner;
+}
+
+// Ranks laid out row-major on a near-square grid, with one communicator per
+// grid row (rank = grid column) and one per grid column (rank = grid row).
+class ProcessGrid {
+    public:
+        int rank;
+        int size;
+        int rows;
+        int cols;
+        int row;
+        int col;
+
+        MPI_Comm row_comm;
+        MPI_Comm col_comm;
+
+        ProcessGrid(MPI_Comm comm) {
+            MPI_Comm_rank(comm, &rank);
+            MPI_Comm_size(comm, &size);
+
+            int dims[2] = { 0, 0 };
+            MPI_Dims_create(size, 2, dims);
+            rows = dims[0];
+            cols = dims[1];
+            row = rank / cols;
+            col = rank % cols;
+
+            MPI_Comm_split(comm, row, col, &row_comm);
+            MPI_Comm_split(comm, col, row, &col_comm);
+        }
+
+        ProcessGrid(const ProcessGrid&) = delete;
+
+        ~ProcessGrid() {
+            MPI_Comm_free(&row_comm);
+            MPI_Comm_free(&col_comm);
+        }
+};
+
+// Grid position (r, c) owns rows r of A and C, columns c of B and C, depth
+// block c of A and depth block r of B. Every step broadcasts one A panel
+// along grid rows and one B panel along grid columns; the next step's
+// broadcasts are in flight while the blocked kernel works on the current one.
+class SummaMultiplier {
+    private:
+        struct Panel {
+            std::size_t k_begin;
+            std::size_t width;
+            int a_root;
+            int b_root;
+        };
+
+        const ProcessGrid& grid;
+        const SummaOptions options;
+
+        std::size_t row_begin, local_rows;
+        std::size_t col_begin, local_cols;
+        std::size_t a_k_begin, a_depth;
+        std::size_t b_k_begin, b_depth;
+
+        Matrix<int32_t> local_a;
+        Matrix<int32_t> local_b;
+        Matrix<int32_t> local_c;
+
+        std::vector<Panel> panels;
+        SummaStats stats;
+
+        std::vector<Panel> _cut_panels() const {
+            std::vector<std::size_t> cuts = { options.depth };
+            for (std::size_t k = 0; k < options.depth; k += options.panel_width)
+                cuts.push_back(k);
+            for (int col = 0; col < grid.cols; col++)
+                cuts.push_back(block_begin(col, options.depth, grid.cols));
+            for (int row = 0; row < grid.rows; row++)
+                cuts.push_back(block_begin(row, options.depth, grid.rows));
+
+            std::sort(cuts.begin(), cuts.end());
+            cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+
+            std::vector<Panel> result;
+            for (std::size_t cut_index = 0; cut_index + 1 < cuts.size(); cut_index++) {
+                const std::size_t k_begin = cuts[cut_index];
+                result.push_back({ k_begin, cuts[cut_index + 1] - k_begin,
+                        static_cast<int>(block_owner(k_begin, options.depth, grid.cols)),
+                        static_cast<int>(block_owner(k_begin, options.depth, grid.rows)) });
+            }
+
+            return result;
+        }
+
+        // Posts both broadcasts of a panel into the given buffers. The roots
+        // first copy their slice out of the local blocks.
+        void _post_panel(const Panel& panel, std::vector<int32_t>& a_panel, std::vector<int32_t>& b_panel,
+                         MPI_Request* requests) {
+            if (grid.col == panel.a_root)
+                for (std::size_t row_index = 0; row_index < local_rows; row_index++) {
+                    const int32_t* source = local_a.row(row_index) + panel.k_begin - a_k_begin;
+                    std::copy(source, source + panel.width, a_panel.data() + row_index * panel.width);
+                }
+            else
+                stats.bytes_received += local_rows * panel.width * sizeof(int32_t);
+
+            if (grid.row == panel.b_root)
+                std::copy(local_b.row(panel.k_begin - b_k_begin), local_b.row(panel.k_begin - b_k_begin + panel.width),
+                        b_panel.data());
+            else
+                stats.bytes_received += panel.width * local_cols * sizeof(int32_t);
+
+            MPI_Ibcast(a_panel.data(), static_cast<int>(local_rows * panel.width), MPI_INT32_T, panel.a_root,
+                    grid.row_comm, &requests[0]);
+            MPI_Ibcast(b_panel.data(), static_cast<int>(panel.width * local_cols), MPI_INT32_T, panel.b_root,
+                    grid.col_comm, &requests[1]);
+        }
+
+        void _wait(MPI_Request* requests) {
+            const double t_start = MPI_Wtime();
+            MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+            stats.wait_s += MPI_Wtime() - t_start;
+        }
+
+        // C += A panel * B panel, one row block at a time; between blocks the
+        // in-flight broadcasts get a chance to progress.
+        void _multiply_panel(const Panel& panel, const std::vector<int32_t>& a_panel,
+                             const std::vector<int32_t>& b_panel, MPI_Request* in_flight) {
+            const ConstMatrixView<int32_t> A = { a_panel.data(), panel.width };
+            const ConstMatrixView<int32_t> B = { b_panel.data(), local_cols };
+
+            for (std::size_t row_block = 0; row_block < local_rows; row_block += GEMM_MC) {
+                gemm_blocked(std::min(GEMM_MC, local_rows - row_block), local_cols, panel.width,
+                        A.block(row_block, 0), B, local_c.view().block(row_block, 0));
+
+                if (in_flight) {
+                    int completed;
+                    MPI_Testall(2, in_flight, &completed, MPI_STATUSES_IGNORE);
+                }
+            }
+        }
+
+    public:
+        SummaMultiplier(const ProcessGrid& grid, const SummaOptions& options)
+            : grid(grid), options(options),
+            row_begin(block_begin(grid.row, options.rows, grid.rows)),
+            local_rows(block_begin(grid.row + 1, options.rows, grid.rows) - row_begin),
+            col_begin(block_begin(grid.col, options.cols, grid.cols)),
+            local_cols(block_begin(grid.col + 1, options.cols, grid.cols) - col_begin),
+            a_k_begin(block_begin(grid.col, options.depth, grid.cols)),
+            a_depth(block_begin(grid.col + 1, options.depth, grid.cols) - a_k_begin),
+            b_k_begin(block_begin(grid.row, options.depth, grid.rows)),
+            b_depth(block_begin(grid.row + 1, options.depth, grid.rows) - b_k_begin),
+            local_a(a_depth, local_rows), local_b(local_cols, b_depth), local_c(local_cols, local_rows),
+            panels(_cut_panels()) {
+            for (std::size_t row_index = 0; row_index < local_rows; row_index++)
+                for (std::size_t k = 0; k < a_depth; k++)
+                    local_a.set(row_index, k, a_element(row_begin + row_index, a_k_begin + k));
+
+            for (std::size_t k = 0; k < b_depth; k++)
+                for (std::size_t col_index = 0; col_index < local_cols; col_index++)
+                    local_b.set(k, col_index, b_element(b_k_begin + k, col_begin + col_index));
+        }
+
+        void run(MPI_Comm comm) {
+            std::size_t max_width = 0;
+            for (const auto& panel : panels)
+                max_width = std::max(max_width, panel.width);
+
+            // Double-buffered: panel step + 1 lands in one pair while step is
+            // multiplied out of the other.
+            std::vector<int32_t> a_panels[2] = { std::vector<int32_t>(local_rows * max_width),
+                                                 std::vector<int32_t>(local_rows * max_width) };
+            std::vector<int32_t> b_panels[2] = { std::vector<int32_t>(max_width * local_cols),
+                                                 std::vector<int32_t>(max_width * local_cols) };
+            MPI_Request requests[2][2];
+
+            MPI_Barrier(comm);
+            const double t_start = MPI_Wtime();
+
+            _post_panel(panels[0], a_panels[0], b_panels[0], requests[0]);
+            for (std::size_t step = 0; step < panels.size(); step++) {
+                const std::size_t current = step % 2;
+                MPI_Request* next_requests = nullptr;
+
+                _wait(requests[current]);
+                if (step + 1 < panels.size()) {
+                    next_requests = requests[1 - current];
+                    _post_panel(panels[step + 1], a_panels[1 - current], b_panels[1 - current], next_requests);
+                }
+
+                _multiply_panel(panels[step], a_panels[current], b_panels[current], next_requests);
+            }
+
+            stats.elapsed_s = MPI_Wtime() - t_start;
+        }
+
+        // Recomputes sampled local elements of C from the element functions.
+        void verify() {
+            if (local_rows == 0 || local_cols == 0)
+                return;
+
+            for (std::size_t sample = 0; sample < VERIFY_SAMPLES; sample++) {
+                const std::size_t row_index = (sample * 7919) % local_rows;
+                const std::size_t col_index = (sample * 104729) % local_cols;
+
+                int32_t expected = 0;
+                for (std::size_t k = 0; k < options.depth; k++)
+                    expected += a_element(row_begin + row_index, k) * b_element(k, col_begin + col_index);
+
+                if (local_c.get(row_index, col_index) != expected)
+                    stats.mismatch_count++;
+            }
+        }
+
+        const SummaStats& get_stats() const {
+            return stats;
+        }
+};
+
+// Runs one multiplication on comm and prints a summary line on its rank 0.
+void run_summa(MPI_Comm comm, const SummaOptions& options) {
+    const ProcessGrid grid(comm);
+
+    SummaMultiplier multiplier(grid, options);
+    multiplier.run(comm);
+    multiplier.verify();
+    const SummaStats& stats = multiplier.get_stats();
+
+    double max_elapsed_s, max_wait_s;
+    MPI_Reduce(&stats.elapsed_s, &max_elapsed_s, 1, MPI_DOUBLE, MPI_MAX, summa::CHIEF_RANK, comm);
+    MPI_Reduce(&stats.wait_s, &max_wait_s, 1, MPI_DOUBLE, MPI_MAX, summa::CHIEF_RANK, comm);
+
+    const std::uint64_t local_counts[2] = { stats.bytes_received, stats.mismatch_count };
+    std::uint64_t global_counts[2];
+    MPI_Reduce(local_counts, global_counts, 2, MPI_UINT64_T, MPI_SUM, summa::CHIEF_RANK, comm);
+
+    if (grid.rank == summa::CHIEF_RANK) {
+        const double flop = 2.0 * options.rows * options.depth * options.cols;
+
+        std::cout << grid.size << " ranks (" << grid.rows << "x" << grid.cols << " grid): "
+            << max_elapsed_s * 1000.0 << "ms, " << flop / (max_elapsed_s * 1e9) << " GFLOP/s, "
+            << global_counts[0] / 1e6 << "MB broadcast (" << global_counts[0] / 1e6 / grid.size << "MB per rank), "
+            << max_wait_s * 1000.0 << "ms max exposed wait";
+        if (global_counts[1])
+            std::cout << ", " << global_counts[1] << " WRONG ELEMENTS";
+        std::cout << std::endl;
+    }
+}
+
+void print_usage(const char* program) {
+    std::cerr << "Usage: mpirun -np N " << program << " [options]" << std::endl
+        << "  --size N          square problem, N x N times N x N (default " << DEFAULT_MATRIX_SIZE << ")" << std::endl
+        << "  --shape M K N     A is M x K, B is K x N" << std::endl
+        << "  --panel N         depth of the panels broadcast per step (default "
+            << DEFAULT_PANEL_WIDTH << ")" << std::endl
+        << "  --scaling         repeat on the first 1, 2, 4, ... ranks and on all of them" << std::endl;
+}
+
+int main(int argc, char **argv) {
+    MPI_Init(&argc, &argv);
+
+    int cluster_size;
+    MPI_Comm_size(MPI_COMM_WORLD, &cluster_size);
+
+    int process_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &process_rank);
+
+    // Every rank parses the same arguments, so all of them agree on whether
+    // to run; only the chief reports a bad one.
+    SummaOptions options;
+    bool scaling = false;
+    bool valid_options = true;
+    try {
+        for (int arg_index = 1; arg_index < argc && valid_options; arg_index++) {
+            const std::string arg = argv[arg_index];
+            const bool has_value = arg_index + 1 < argc;
+
+            if (arg == "--size" && has_value)
+                options.rows = options.depth = options.cols = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--shape" && arg_index + 3 < argc) {
+                options.rows = std::max(1ul, std::stoul(argv[++arg_index]));
+                options.depth = std::max(1ul, std::stoul(argv[++arg_index]));
+                options.cols = std::max(1ul, std::stoul(argv[++arg_index]));
+            }
+            else if (arg == "--panel" && has_value)
+                options.panel_width = std::max(1ul, std::stoul(argv[++arg_index]));
+            else if (arg == "--scaling")
+                scaling = true;
+            else
+                valid_options = false;
+        }
+    } catch (const std::exception& error) {
+        if (process_rank == summa::CHIEF_RANK)
+            std::cerr << "Invalid option value: " << error.what() << std::endl;
+        valid_options = false;
+    }
+
+    if (!valid_options) {
+        if (process_rank == summa::CHIEF_RANK)
+            print_usage(argv[0]);
+
+        MPI_Finalize();
+        return 1;
+    }
+
+    if (process_rank == summa::CHIEF_RANK)
+        std::cout << "SUMMA " << options.rows << "x" << options.depth << " * " << options.depth << "x"
+            << options.cols << ", panel " << options.panel_width << std::endl;
+
+    if (!scaling) {
+        run_summa(MPI_COMM_WORLD, options);
+        MPI_Finalize();
+        return 0;
+    }
+
+    std::vector<int> rank_counts;
+    for (int rank_count = 1; rank_count < cluster_size; rank_count *= 2)
+        rank_counts.push_back(rank_count);
+    rank_counts.push_back(cluster_size);
+
+    // The ranks left out of a round idle at the barrier.
+    for (const int rank_count : rank_counts) {
+        MPI_Comm comm;
+        MPI_Comm_split(MPI_COMM_WORLD, process_rank < rank_count ? 0 : MPI_UNDEFINED, process_rank, &comm);
+
+        if (comm != MPI_COMM_NULL) {
+            run_summa(comm, options);
+            MPI_Comm_free(&comm);
+        }
+
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+
+    MPI_Finalize();
+
+    return 0;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "matrix.h"
+
+// CSR keeps the nonzeros row by row, CSC column by column.
+enum class SparseLayout { CSR, CSC };
+
+// Compressed sparse matrix. For CSR, the nonzeros of row r are positions
+// [offsets[r], offsets[r + 1]) of indices (their columns) and values; CSC is
+// the same with rows and columns swapped. Within a row (column) indices are
+// ascending. Storage is O(nonzeros + major dimension).
+class SparseMatrix {
+    private:
+        std::vector<std::size_t> offsets;
+        std::vector<uint32_t> indices;
+        std::vector<int32_t> values;
+
+        // Indices are 32-bit, so the minor dimension must fit in them.
+        static void _check_index_width(std::size_t minor_count) {
+            if (minor_count > static_cast<std::size_t>(std::numeric_limits<uint32_t>::max()) + 1)
+                throw std::runtime_error("Sparse matrix dimension " + std::to_string(minor_count) 
+                        + " exceeds 32-bit indices");
+        }
+
+    public:
+        const std::size_t width;
+        const std::size_t height;
+        const SparseLayout layout;
+
+        // An all-zero matrix.
+        SparseMatrix(std::size_t width, std::size_t height, SparseLayout layout = SparseLayout::CSR)
+            : offsets((layout == SparseLayout::CSR ? height : width) + 1, 0),
+            width(width), height(height), layout(layout) {}
+
+        SparseMatrix(std::size_t width, std::size_t height, SparseLayout layout, std::vector<std::size_t> offsets,
+                     std::vector<uint32_t> indices, std::vector<int32_t> values)
+            : offsets(std::move(offsets)), indices(std::move(indices)), values(std::move(values)),
+            width(width), height(height), layout(layout) {
+            assert(this->offsets.size() == major_size() + 1);
+            assert(this->indices.size() == this->values.size() && this->values.size() == this->offsets.back());
+        }
+
+        static SparseMatrix from_dense(const Matrix<int32_t>& dense, SparseLayout layout = SparseLayout::CSR) {
+            const bool by_rows = layout == SparseLayout::CSR;
+            const std::size_t major_count = by_rows ? dense.height : dense.width;
+            const std::size_t minor_count = by_rows ? dense.width : dense.height;
+            _check_index_width(minor_count);
+
+            std::vector<std::size_t> offsets = { 0 };
+            std::vector<uint32_t> indices;
+            std::vector<int32_t> values;
+            offsets.reserve(major_count + 1);
+
+            for (std::size_t major = 0; major < major_count; major++) {
+                for (std::size_t minor = 0; minor < minor_count; minor++) {
+                    const int32_t value = by_rows ? dense.get(major, minor) : dense.get(minor, major);
+                    if (value != 0) {
+                        indices.push_back(static_cast<uint32_t>(minor));
+                        values.push_back(value);
+                    }
+                }
+                offsets.push_back(values.size());
+            }
+
+            return SparseMatrix(dense.width, dense.height, layout, std::move(offsets), std::move(indices), std::move(values));
+        }
+
+        Matrix<int32_t> to_dense() const {
+            Matrix<int32_t> dense(width, height, 0);
+            for (std::size_t major = 0; major < major_size(); major++)
+                for (std::size_t position = begin(major); position < end(major); position++) {
+                    if (layout == SparseLayout::CSR)
+                        dense.set(major, indices[position], values[position]);
+                    else
+                        dense.set(indices[position], major, values[position]);
+                }
+
+            return dense;
+        }
+
+        // CSR <-> CSC by a counting sort over the minor indices; visiting the
+        // majors in order keeps the new indices ascending.
+        SparseMatrix to_layout(SparseLayout target) const {
+            if (target == layout)
+                return *this;
+
+            const std::size_t minor_count = layout == SparseLayout::CSR ? width : height;
+            _check_index_width(major_size());
+
+            std::vector<std::size_t> target_offsets(minor_count + 1, 0);
+            for (const uint32_t index : indices)
+                target_offsets[index + 1]++;
+            for (std::size_t minor = 0; minor < minor_count; minor++)
+                target_offsets[minor + 1] += target_offsets[minor];
+
+            std::vector<std::size_t> cursor(target_offsets.begin(), target_offsets.end() - 1);
+            std::vector<uint32_t> target_indices(indices.size());
+            std::vector<int32_t> target_values(values.size());
+
+            for (std::size_t major = 0; major < major_size(); major++)
+                for (std::size_t position = begin(major); position < end(major); position++) {
+                    const std::size_t target_position = cursor[indices[position]]++;
+                    target_indices[target_position] = static_cast<uint32_t>(major);
+                    target_values[target_position] = values[position];
+                }
+
+            return SparseMatrix(width, height, target, std::move(target_offsets),
+                    std::move(target_indices), std::move(target_values));
+        }
+
+        // Rows for CSR, columns for CSC.
+        std::size_t major_size() const {
+            return layout == SparseLayout::CSR ? height : width;
+        }
+
+        std::size_t begin(std::size_t major) const {
+            return offsets[major];
+        }
+
+        std::size_t end(std::size_t major) const {
+            return offsets[major + 1];
+        }
+
+        uint32_t index(std::size_t position) const {
+            return indices[position];
+        }
+
+        int32_t value(std::size_t position) const {
+            return values[position];
+        }
+
+        std::size_t nonzero_count() const {
+            return values.size();
+        }
+
+        std::size_t memory_bytes() const {
+            return offsets.size() * sizeof(std::size_t) + indices.size() * sizeof(uint32_t)
+                + values.size() * sizeof(int32_t);
+        }
+};